@@ -7,11 +7,116 @@
  *   Last modification: 4 September 2002
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
 #include <mpi.h>
 #include "MyMPI.h"
 
+/* Compressed files are decoded only with the codecs the
+   library is built with: -DHAVE_ZLIB (link with -lz) and/or
+   -DHAVE_ZSTD (link with -lzstd). */
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* MPI-IO is part of MPI-2. Compile with -DNO_MPI_IO to force
+   the readers to funnel the file through a single process. */
+
+#if defined(MPI_VERSION) && (MPI_VERSION >= 2) && !defined(NO_MPI_IO)
+#define USE_MPI_IO
+#endif
+
+/* Non-blocking collectives are part of MPI-3. Without them
+   a replication runs to completion when it is started. */
+
+#if defined(MPI_VERSION) && (MPI_VERSION >= 3)
+#define USE_NONBLOCKING_COLL
+#endif
+
+/* Shared-memory windows are part of MPI-3 as well. Without
+   them a hierarchical replicate plan falls back to a private
+   copy of the vector on every process. */
+
+#if defined(MPI_VERSION) && (MPI_VERSION >= 3) && \
+    !defined(NO_SHARED_WINDOW)
+#define USE_SHARED_WINDOW
+#endif
+
+/* Persistent collectives are part of MPI-4. Compile with
+   -DNO_PERSISTENT_COLL to start a fresh collective each
+   time a replicate plan is executed. */
+
+#if defined(MPI_VERSION) && (MPI_VERSION >= 4) && \
+    !defined(NO_PERSISTENT_COLL)
+#define USE_PERSISTENT_COLL
+#endif
+
+/* Memory-mapped input needs POSIX 'mmap'. Compile with
+   -DNO_MMAP on systems that lack it. */
+
+#ifndef NO_MMAP
+#define USE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Input checksums use the SSE4.2 CRC32C instruction where the
+   compiler targets it, and a table otherwise */
+
+#if defined(__SSE4_2__) && defined(__x86_64__)
+#define USE_CRC32C_INSN
+#include <nmmintrin.h>
+#endif
+
+/* Complex elements are laid out as C99 double _Complex,
+   which MPI-2.2 names MPI_C_DOUBLE_COMPLEX */
+
+#ifdef MPI_C_DOUBLE_COMPLEX
+#define HAVE_MPI_COMPLEX
+#endif
+
+typedef struct {
+   double re;
+   double im;
+} dcomplex;
+
+static int input_mode = READ_COPY;  /* How readers get data */
+static int input_batch_rows = 0;    /* Rows per scatter, or 0
+                                       to fill about
+                                       DEFAULT_BATCH_BYTES */
+static int input_checksum = 0;      /* Checksum what is read? */
+static unsigned long long last_checksum = 0; /* Of last input */
+static double last_checksum_seconds = 0.0;   /* Time it took */
+
+#ifdef USE_MMAP
+
+/* Each mapping made by a reader is remembered so that
+   'free_storage' can tell mapped storage from heap storage */
+
+typedef struct mapping {
+   void           *data;  /* Address handed to the caller */
+   void           *base;  /* Page-aligned start of mapping */
+   size_t          len;   /* Bytes mapped */
+   struct mapping *next;
+} mapping;
+
+static mapping *mappings = NULL;
+
+#endif
+
 
 /***************** MISCELLANEOUS FUNCTIONS *****************/
 
@@ -21,13 +126,22 @@
  */
 
 int get_size (MPI_Datatype t) {
+   int size;   /* Size reported by MPI */
+
    if (t == MPI_BYTE) return sizeof(char);
    if (t == MPI_DOUBLE) return sizeof(double);
    if (t == MPI_FLOAT) return sizeof(float);
    if (t == MPI_INT) return sizeof(int);
+   if (t == MPI_LONG_LONG) return sizeof(long long);
+#ifdef HAVE_MPI_COMPLEX
+   if (t == MPI_C_DOUBLE_COMPLEX) return sizeof(dcomplex);
+#endif
+   if ((MPI_Type_size (t, &size) == MPI_SUCCESS) && (size > 0))
+      return size;
    printf ("Error: Unrecognized argument to 'get_size'\n");
    fflush (stdout);
    MPI_Abort (MPI_COMM_WORLD, TYPE_ERROR);
+   return 0;
 }
 
 
@@ -39,11 +153,11 @@ int get_size (MPI_Datatype t) {
  */
 
 void *my_malloc (
-   int id,     /* IN - Process rank */
-   int bytes)  /* IN - Bytes to allocate */
+   int    id,     /* IN - Process rank */
+   size_t bytes)  /* IN - Bytes to allocate */
 {
    void *buffer;
-   if ((buffer = malloc ((size_t) bytes)) == NULL) {
+   if ((buffer = malloc (bytes)) == NULL) {
       printf ("Error: Malloc failed for process %d\n", id);
       fflush (stdout);
       MPI_Abort (MPI_COMM_WORLD, MALLOC_ERROR);
@@ -52,6 +166,429 @@ void *my_malloc (
 }
 
 
+/*
+ *   Function 'set_input_mode' selects how subsequent calls to
+ *   the input functions obtain their data. READ_COPY (the
+ *   default) reads the file into freshly allocated storage.
+ *   READ_MMAP maps each process's part of the file into its
+ *   address space (copy-on-write), so that the returned
+ *   arrays point straight into the mapping. It is meant for
+ *   runs where all processes share one node, and is honored
+ *   by 'read_row_striped_matrix', 'read_col_striped_matrix'
+ *   and 'read_replicated_vector'.
+ */
+
+void set_input_mode (
+   int mode)   /* IN - READ_COPY or READ_MMAP */
+{
+   input_mode = mode;
+}
+
+
+/*
+ *   Function 'set_input_batch_rows' sets how many matrix rows
+ *   'read_col_striped_matrix' reads and scatters at a time.
+ *   A value of 0 (the default) picks enough rows to fill
+ *   about DEFAULT_BATCH_BYTES.
+ */
+
+void set_input_batch_rows (
+   int rows)   /* IN - Rows per batch, or 0 */
+{
+   input_batch_rows = rows;
+}
+
+
+/*
+ *   Function 'set_input_checksum' turns checksums of input on
+ *   or off. When they are on, every input function ends by
+ *   having each process checksum the elements it received,
+ *   in parallel, and combining the results over the
+ *   communicator. The checksum is the CRC32C of the elements
+ *   of the file in file order, so it is the same whatever
+ *   the number of processes and whichever function reads
+ *   it. Process 0 prints the checksum and the time spent
+ *   computing it.
+ */
+
+void set_input_checksum (
+   int on)     /* IN - Nonzero to checksum input */
+{
+   input_checksum = on;
+}
+
+
+/*
+ *   Function 'get_input_checksum' returns the checksum of the
+ *   most recent input and, if 'seconds' is not NULL, the
+ *   time it took.
+ */
+
+unsigned long long get_input_checksum (
+   double *seconds)   /* OUT - Time spent, or NULL */
+{
+   if (seconds != NULL) *seconds = last_checksum_seconds;
+   return last_checksum;
+}
+
+
+/*
+ *   Function 'my_fread' reads 'count' items as 'fread' does,
+ *   but aborts the computation if the file holds fewer. A
+ *   truncated file would otherwise leave garbage in the
+ *   matrix.
+ */
+
+static void my_fread (
+   int    id,       /* IN - Process rank */
+   void  *ptr,      /* OUT - Items read */
+   size_t size,     /* IN - Bytes per item */
+   size_t count,    /* IN - Items to read */
+   FILE  *f)        /* IN - Input file */
+{
+   if (fread (ptr, size, count, f) != count) {
+      printf ("Error: Input file too short on process %d\n", id);
+      fflush (stdout);
+      MPI_Abort (MPI_COMM_WORLD, READ_ERROR);
+   }
+}
+
+
+/*
+ *   Function 'check_read' does the same for an MPI-IO read,
+ *   whose result is in 'status'.
+ */
+
+static void check_read (
+   int          id,      /* IN - Process rank */
+   MPI_Status  *status,  /* IN - Result of read */
+   MPI_Datatype dtype,   /* IN - Type of items read */
+   int          count)   /* IN - Items expected */
+{
+   int got;              /* Items read */
+
+   MPI_Get_count (status, dtype, &got);
+   if (got != count) {
+      printf ("Error: Input file too short on process %d\n", id);
+      fflush (stdout);
+      MPI_Abort (MPI_COMM_WORLD, READ_ERROR);
+   }
+}
+
+
+/*
+ *   Function 'crc32c' extends the CRC32C (Castagnoli) 'crc'
+ *   of some bytes with 'len' more. Without the SSE4.2
+ *   instruction it works eight bytes at a time with eight
+ *   tables ("slicing by 8").
+ */
+
+static unsigned int crc32c (
+   unsigned int   crc,  /* IN - CRC so far */
+   unsigned char *p,    /* IN - Bytes */
+   size_t         len)  /* IN - Number of bytes */
+{
+#ifdef USE_CRC32C_INSN
+   unsigned long long word;    /* Next 8 bytes */
+
+   for (; len >= 8; len -= 8, p += 8) {
+      memcpy (&word, p, 8);
+      crc = (unsigned int) _mm_crc32_u64 (crc, word);
+   }
+   for (; len; len--) crc = _mm_crc32_u8 (crc, *p++);
+#else
+   static unsigned int table[8][256];  /* CRC of byte k
+                                          places from end */
+   unsigned int        c;
+   int                 i, k;
+
+   if (!table[0][1]) {
+      for (i = 0; i < 256; i++) {
+         c = i;
+         for (k = 0; k < 8; k++)
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+         table[0][i] = c;
+      }
+      for (i = 0; i < 256; i++)
+         for (k = 1; k < 8; k++)
+            table[k][i] = table[0][table[k-1][i] & 0xff] ^
+               (table[k-1][i] >> 8);
+   }
+   for (; len >= 8; len -= 8, p += 8) {
+      c = crc ^ (p[0] | p[1] << 8 | p[2] << 16 |
+         (unsigned int) p[3] << 24);
+      crc = table[7][c & 0xff] ^ table[6][(c >> 8) & 0xff] ^
+         table[5][(c >> 16) & 0xff] ^ table[4][c >> 24] ^
+         table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^
+         table[0][p[7]];
+   }
+   for (; len; len--)
+      crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+#endif
+   return crc;
+}
+
+
+/*
+ *   Function 'gf2_times' returns the product of a 32 x 32
+ *   matrix over GF(2), stored a column per word, and 'v'.
+ */
+
+static unsigned int gf2_times (
+   unsigned int *mat,   /* IN - Matrix */
+   unsigned int  v)     /* IN - Vector */
+{
+   unsigned int sum;    /* Product */
+   int          b;
+
+   for (sum = 0, b = 0; v; b++, v >>= 1)
+      if (v & 1) sum ^= mat[b];
+   return sum;
+}
+
+
+/*
+ *   Function 'crc32c_zeros' extends the CRC32C 'crc' of some
+ *   bytes with 'len' zero bytes, in time proportional to
+ *   log 'len'. A CRC is linear, so the CRCs of separate
+ *   pieces of a file, each extended to the end of the file
+ *   this way, combine into the CRC of the whole file with
+ *   exclusive or.
+ */
+
+static unsigned int crc32c_zeros (
+   unsigned int crc,    /* IN - CRC so far */
+   long long    len)    /* IN - Number of zero bytes */
+{
+   static unsigned int op[63][32]; /* Effect of 2^k zero
+                                      bytes on each bit */
+   static int          ready = 0;
+   unsigned char       zero = 0;
+   int                 b, k;
+
+   if (!ready) {
+      for (b = 0; b < 32; b++)
+         op[0][b] = crc32c (1U << b, &zero, 1);
+      for (k = 1; k < 63; k++)
+         for (b = 0; b < 32; b++)
+            op[k][b] = gf2_times (op[k-1], op[k-1][b]);
+      ready = 1;
+   }
+   for (k = 0; len; k++, len >>= 1)
+      if (len & 1) crc = gf2_times (op[k], crc);
+   return crc;
+}
+
+
+/*
+ *   Function 'hash_block' returns a process's share of the
+ *   CRC32C of a file's elements: the CRC, starting from zero,
+ *   of the file with every element outside a 'rows' x 'cols'
+ *   block set to zero. The rows of the block are 'ld'
+ *   elements apart in memory, and element (i,j) of the block
+ *   is element 'first' + i*'file_ld' + j of the 'total' in
+ *   the file. Each row is one run of the CRC, so this goes
+ *   as fast as 'crc32c' does.
+ */
+
+static unsigned int hash_block (
+   void     *a,         /* IN - First element of block */
+   int       rows,      /* IN - Rows in block */
+   int       cols,      /* IN - Cols in block */
+   int       ld,        /* IN - Elements between rows */
+   long long first,     /* IN - Position of first element */
+   long long file_ld,   /* IN - File elements between rows */
+   long long total,     /* IN - Elements in file */
+   int       size)      /* IN - Bytes per element */
+{
+   unsigned int crc;    /* CRC so far */
+   int          i;
+
+   if (!rows || !cols) return 0;
+   crc = 0;
+   for (i = 0; i < rows; i++) {
+      if (i) crc = crc32c_zeros (crc, (file_ld - cols) * size);
+      crc = crc32c (crc, (unsigned char *) a +
+         (size_t) i * ld * size, (size_t) cols * size);
+   }
+   return crc32c_zeros (crc, (total - first -
+      (long long) (rows - 1) * file_ld - cols) * size);
+}
+
+
+/*
+ *   Function 'report_checksum' combines the processes'
+ *   shares 'crc' of the CRC32C of the 'bytes' bytes of
+ *   elements in file 's' and records the result. 'seconds'
+ *   holds minus the time the process started on its share.
+ */
+
+static void report_checksum (
+   char              *s,        /* IN - File name */
+   unsigned int       crc,      /* IN - Process's share */
+   long long          bytes,    /* IN - Bytes of elements */
+   double             seconds,  /* IN - Minus start time */
+   MPI_Comm           comm)     /* IN - Communicator */
+{
+   unsigned int all;            /* Combined shares */
+   int          id;             /* Process rank */
+
+   MPI_Comm_rank (comm, &id);
+   MPI_Allreduce (&crc, &all, 1, MPI_UNSIGNED, MPI_BXOR, comm);
+   last_checksum = ~(all ^ crc32c_zeros (0xFFFFFFFF, bytes)) &
+      0xFFFFFFFF;
+   seconds += MPI_Wtime();
+   MPI_Allreduce (&seconds, &last_checksum_seconds, 1,
+      MPI_DOUBLE, MPI_MAX, comm);
+   if (!id) {
+      printf ("Checksum of '%s': %08llx (%.6f sec)\n", s,
+         last_checksum, last_checksum_seconds);
+      fflush (stdout);
+   }
+}
+
+
+/*
+ *   Function 'check_block' checksums the block of a file a
+ *   process has read, as 'hash_block' describes, if input
+ *   checksums are on.
+ */
+
+static void check_block (
+   char        *s,        /* IN - File name */
+   void        *a,        /* IN - First element of block */
+   int          rows,     /* IN - Rows in block */
+   int          cols,     /* IN - Cols in block */
+   int          ld,       /* IN - Elements between rows */
+   long long    first,    /* IN - Position of first element */
+   long long    file_ld,  /* IN - File elements between rows */
+   long long    total,    /* IN - Elements in file */
+   MPI_Datatype dtype,    /* IN - Element type */
+   MPI_Comm     comm)     /* IN - Communicator */
+{
+   double seconds;        /* Minus start time */
+   int    size;           /* Bytes per element */
+
+   if (!input_checksum) return;
+   seconds = -MPI_Wtime();
+   size = get_size (dtype);
+   report_checksum (s, hash_block (a, rows, cols, ld, first,
+      file_ld, total, size), total * size, seconds, comm);
+}
+
+
+/*
+ *   Function 'alloc_aligned_matrix' allocates a 'rows' x
+ *   'cols' matrix whose rows all begin on an ALIGN_BYTES
+ *   boundary, padding each row as needed. With
+ *   ALLOC_HUGE_PAGES a large matrix is aligned to, and
+ *   advised to use, transparent huge pages. With
+ *   ALLOC_FIRST_TOUCH the matrix is zeroed at once, by the
+ *   OpenMP threads in the static schedule the kernels use,
+ *   so that each page lands on the NUMA node of the thread
+ *   that will work on it.
+ */
+
+void alloc_aligned_matrix (
+   int             id,     /* IN - Process rank */
+   int             rows,   /* IN - Rows */
+   int             cols,   /* IN - Cols */
+   MPI_Datatype    dtype,  /* IN - Element type */
+   int             flags,  /* IN - ALLOC_* flags */
+   aligned_matrix *a)      /* OUT - Matrix */
+{
+   size_t align;           /* Alignment of 'base' */
+   size_t bytes;           /* Bytes allocated */
+   int    datum_size;      /* Bytes per element */
+   int    i;
+
+   datum_size = get_size (dtype);
+   a->rows = rows;
+   a->cols = cols;
+   a->ld = CEILING(CEILING(cols * datum_size, ALIGN_BYTES) *
+      ALIGN_BYTES, datum_size);
+   bytes = MAX((size_t) rows * a->ld * datum_size, 1);
+   align = ALIGN_BYTES;
+#if defined(USE_MMAP) && defined(MADV_HUGEPAGE)
+   if ((flags & ALLOC_HUGE_PAGES) && (bytes >= (2 << 20))) {
+      align = 2 << 20;
+      bytes = CEILING(bytes, align) * align;
+   }
+#endif
+   if (posix_memalign (&a->base, align, bytes)) {
+      printf ("Error: Malloc failed for process %d\n", id);
+      fflush (stdout);
+      MPI_Abort (MPI_COMM_WORLD, MALLOC_ERROR);
+   }
+#if defined(USE_MMAP) && defined(MADV_HUGEPAGE)
+   if (align > ALIGN_BYTES)
+      madvise (a->base, bytes, MADV_HUGEPAGE);
+#endif
+   if (flags & ALLOC_FIRST_TOUCH) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (i = 0; i < rows; i++)
+         memset (a->base + (size_t) i * a->ld * datum_size, 0,
+            (size_t) a->ld * datum_size);
+   }
+   a->subs = (void **) my_malloc (id, MAX(rows,1) * PTR_SIZE);
+   for (i = 0; i < rows; i++)
+      a->subs[i] = a->base + (size_t) i * a->ld * datum_size;
+}
+
+
+void free_aligned_matrix (
+   aligned_matrix *a)      /* IN - Matrix */
+{
+   free (a->base);
+   free (a->subs);
+}
+
+
+/*
+ *   Function 'free_csr_matrix' releases the arrays of a
+ *   sparse matrix filled in by 'read_row_striped_csr'.
+ */
+
+void free_csr_matrix (
+   csr_matrix *a)   /* IN - Sparse matrix */
+{
+   free (a->row_ptr);
+   free (a->col_idx);
+   free (a->values);
+   free (a->row_cnt);
+   free (a->row_disp);
+}
+
+
+/*
+ *   Function 'free_storage' releases the element storage
+ *   returned by an input function, whether it was allocated
+ *   from the heap or mapped from the input file.
+ */
+
+void free_storage (
+   void *storage)   /* IN - Storage returned by a reader */
+{
+#ifdef USE_MMAP
+   mapping **mp;    /* Link to current mapping */
+   mapping  *q;     /* Mapping being released */
+
+   for (mp = &mappings; *mp != NULL; mp = &(*mp)->next) {
+      if ((*mp)->data == storage) {
+         q = *mp;
+         *mp = q->next;
+         munmap (q->base, q->len);
+         free (q);
+         return;
+      }
+   }
+#endif
+   free (storage);
+}
+
+
 /*
  *   Function 'terminate' is called when the program should
  *   not continue execution, due to an error condition that
@@ -74,6 +611,152 @@ void terminate (
 }
 
 
+/*
+ *   Given MPI_Datatype 't', function 'get_type_code' returns
+ *   the code that identifies elements of that type in a
+ *   versioned file header.
+ */
+
+static int get_type_code (MPI_Datatype t) {
+   if (t == MPI_BYTE) return TYPE_BYTE;
+   if (t == MPI_DOUBLE) return TYPE_DOUBLE;
+   if (t == MPI_FLOAT) return TYPE_FLOAT;
+   if (t == MPI_INT) return TYPE_INT;
+   if (t == MPI_LONG_LONG) return TYPE_INT64;
+#ifdef HAVE_MPI_COMPLEX
+   if (t == MPI_C_DOUBLE_COMPLEX) return TYPE_COMPLEX;
+#endif
+   return 0;
+}
+
+
+/*
+ *   Function 'parse_header' interprets the first 'bytes'
+ *   bytes of a matrix or vector file, held in 'buf'. A legacy
+ *   file begins with 'ndims' ints giving its dimensions. A
+ *   versioned file begins with a 'file_header' (see MyFile.h),
+ *   whose element type must match 'dtype'. The function
+ *   stores the dimensions in 'dims' and returns the byte
+ *   offset of the first element, or -1 if the header is not
+ *   valid or a dimension does not fit in an int. A file of
+ *   the wrong type or byte order aborts the program.
+ */
+
+static long long parse_header (
+   void        *buf,    /* IN - Start of file */
+   int          bytes,  /* IN - Bytes in 'buf' */
+   int          ndims,  /* IN - 1 for a vector, 2 for a matrix */
+   MPI_Datatype dtype,  /* IN - Expected element type */
+   int         *dims)   /* OUT - Dimensions */
+{
+   file_header *h;      /* Versioned header */
+   int          i;
+   long long    rows;   /* Rows in versioned file */
+   long long    cols;   /* Cols in versioned file */
+
+   h = (file_header *) buf;
+   if ((bytes >= (int) sizeof(int)) &&
+       (h->magic == SWAPPED_FILE_MAGIC)) {
+      printf ("Error: File was written with the other byte order\n");
+      fflush (stdout);
+      MPI_Abort (MPI_COMM_WORLD, TYPE_ERROR);
+   }
+   if ((bytes >= (int) sizeof(int)) && (h->magic == FILE_MAGIC)) {
+      if ((bytes < (int) sizeof(file_header)) ||
+          (h->version != FILE_VERSION) ||
+          (h->endian != ENDIAN_MARK) ||
+          (h->offset < (long long) sizeof(file_header)))
+         return -1;
+      if (h->type != get_type_code (dtype)) {
+         printf ("Error: File holds elements of another type\n");
+         fflush (stdout);
+         MPI_Abort (MPI_COMM_WORLD, TYPE_ERROR);
+      }
+      if (h->layout != LAYOUT_DENSE) {
+         printf ("Error: Sparse matrices are read only by "
+            "'read_row_striped_csr'\n");
+         fflush (stdout);
+         MPI_Abort (MPI_COMM_WORLD, TYPE_ERROR);
+      }
+      if (h->codec != CODEC_NONE) {
+         printf ("Error: Compressed files are read only by "
+            "'read_row_striped_matrix' and "
+            "'read_checkerboard_matrix'\n");
+         fflush (stdout);
+         MPI_Abort (MPI_COMM_WORLD, CODEC_ERROR);
+      }
+      rows = h->rows;
+      cols = h->cols;
+      if (ndims == 1) {
+         rows *= cols;
+         cols = 1;
+      }
+      if ((rows <= 0) || (rows > INT_MAX) ||
+          (cols <= 0) || (cols > INT_MAX))
+         return -1;
+      dims[0] = (int) rows;
+      if (ndims == 2) dims[1] = (int) cols;
+      return h->offset;
+   }
+   if (bytes < ndims * (int) sizeof(int)) return -1;
+   for (i = 0; i < ndims; i++) {
+      dims[i] = ((int *) buf)[i];
+      if (dims[i] <= 0) return -1;
+   }
+   return ndims * sizeof(int);
+}
+
+
+/*
+ *   Function 'fill_header' prepares a versioned header for a
+ *   file of 'rows' x 'cols' elements of type 'dtype'.
+ */
+
+static void fill_header (
+   file_header *h,      /* OUT - Header */
+   MPI_Datatype dtype,  /* IN - Element type */
+   long long    rows,   /* IN - Rows, or vector length */
+   long long    cols)   /* IN - Cols, or 1 */
+{
+   memset (h, 0, sizeof(file_header));
+   h->magic = FILE_MAGIC;
+   h->version = FILE_VERSION;
+   h->type = get_type_code (dtype);
+   h->endian = ENDIAN_MARK;
+   h->rows = rows;
+   h->cols = cols;
+   h->offset = CEILING(sizeof(file_header), DATA_ALIGNMENT) *
+      DATA_ALIGNMENT;
+}
+
+
+/*
+ *   Function 'fread_header' reads the header of an open
+ *   matrix or vector file and leaves the file positioned at
+ *   the first element. If the header is not valid the
+ *   dimensions are set to 0.
+ */
+
+static long long fread_header (
+   FILE        *infileptr, /* IN - Input file pointer */
+   int          ndims,     /* IN - 1 for a vector, 2 for a matrix */
+   MPI_Datatype dtype,     /* IN - Expected element type */
+   int         *dims)      /* OUT - Dimensions */
+{
+   char      buf[MAX_HEADER_BYTES]; /* Start of file */
+   int       i;
+   long long offset;                /* First element */
+
+   offset = parse_header (buf,
+      fread (buf, 1, MAX_HEADER_BYTES, infileptr), ndims,
+      dtype, dims);
+   if (offset < 0)
+      for (i = 0; i < ndims; i++) dims[i] = 0;
+   else fseeko (infileptr, (off_t) offset, SEEK_SET);
+   return offset;
+}
+
+
 /************ DATA DISTRIBUTION FUNCTIONS ******************/
 
 /*
@@ -130,43 +813,1319 @@ void create_uniform_xfer_arrays (
    }
 }
 
+
+/*
+ *   Function 'create_distribution' fills in a descriptor of
+ *   the given kind for 'p' processes. 'block' is used only by
+ *   DIST_BLOCK_CYCLIC, and 'weight' (one positive speed
+ *   factor per process) only by DIST_WEIGHTED.
+ */
+
+void create_distribution (
+   int           kind,    /* IN - DIST_* */
+   int           p,       /* IN - Number of processes */
+   int           block,   /* IN - Elements per block */
+   double       *weight,  /* IN - Weight of each process */
+   distribution *d)       /* OUT - Descriptor */
+{
+   int    i;
+   double total;          /* Sum of weights */
+
+   d->kind = kind;
+   d->p = p;
+   d->block = ((kind == DIST_BLOCK_CYCLIC) && (block > 0)) ?
+      block : 1;
+   d->share = NULL;
+   if (kind == DIST_WEIGHTED) {
+      d->share = (double *) my_malloc (0,
+         (p+1) * sizeof(double));
+      total = 0.0;
+      for (i = 0; i < p; i++) total += weight[i];
+      d->share[0] = 0.0;
+      for (i = 0; i < p; i++)
+         d->share[i+1] = d->share[i] + weight[i] / total;
+      d->share[p] = 1.0;
+   }
+}
+
+
+void free_distribution (
+   distribution *d)       /* IN - Descriptor */
+{
+   free (d->share);
+}
+
+
 /*
- *   This function is used to transform a vector from a
- *   block distribution to a replicated distribution within a
- *   communicator.
+ *   Index of the first of 'n' elements held by process 'id'
+ *   under a distribution that gives each process a single
+ *   contiguous block.
+ */
+
+static int dist_low (distribution *d, int id, int n)
+{
+   if (d->kind == DIST_WEIGHTED)
+      return (id == d->p) ? n : (int) (d->share[id] * n);
+   return BLOCK_LOW(id,d->p,n);
+}
+
+
+/*
+ *   Function 'dist_size' returns the number of the 'n'
+ *   elements that process 'id' holds.
+ */
+
+int dist_size (
+   distribution *d,       /* IN - Descriptor */
+   int           id,      /* IN - Process rank */
+   int           n)       /* IN - Number of elements */
+{
+   int blocks;            /* Blocks of 'block' elements */
+   int size;              /* Elements on 'id' */
+
+   if ((d->kind == DIST_BLOCK) || (d->kind == DIST_WEIGHTED))
+      return dist_low (d, id+1, n) - dist_low (d, id, n);
+   blocks = CEILING(n,d->block);
+   if (id >= blocks) return 0;
+   size = ((blocks - 1 - id) / d->p + 1) * d->block;
+   if ((blocks - 1) % d->p == id)
+      size -= blocks * d->block - n;
+   return size;
+}
+
+
+/*
+ *   Function 'dist_owner' returns the rank of the process
+ *   that holds element 'j' of 'n'.
+ */
+
+int dist_owner (
+   distribution *d,       /* IN - Descriptor */
+   int           j,       /* IN - Element index */
+   int           n)       /* IN - Number of elements */
+{
+   int hi, lo, mid;       /* Bounds of binary search */
+
+   if (d->kind == DIST_BLOCK) return BLOCK_OWNER(j,d->p,n);
+   if (d->kind == DIST_WEIGHTED) {
+      lo = 0;
+      hi = d->p - 1;
+      while (lo < hi) {
+         mid = (lo + hi + 1) / 2;
+         if (dist_low (d, mid, n) <= j) lo = mid;
+         else hi = mid - 1;
+      }
+      return lo;
+   }
+   return (j / d->block) % d->p;
+}
+
+
+/*
+ *   Function 'dist_runs' describes the elements held by
+ *   process 'id' as runs of consecutive indices, in
+ *   increasing order. Adjacent runs are merged, so no two
+ *   runs of a process touch. It allocates and fills the
+ *   arrays of run starts and lengths, and returns the
+ *   number of runs.
+ */
+
+int dist_runs (
+   distribution *d,       /* IN - Descriptor */
+   int           id,      /* IN - Process rank */
+   int           n,       /* IN - Number of elements */
+   int         **start,   /* OUT - First index of each run */
+   int         **len)     /* OUT - Length of each run */
+{
+   int b;                 /* First index of a block */
+   int runs;              /* Runs found */
+
+   runs = CEILING(n,d->block);
+   *start = (int *) my_malloc (id, MAX(runs,1) * sizeof(int));
+   *len = (int *) my_malloc (id, MAX(runs,1) * sizeof(int));
+   runs = 0;
+   if ((d->kind == DIST_BLOCK) || (d->kind == DIST_WEIGHTED)) {
+      if (dist_size (d, id, n) > 0) {
+         (*start)[0] = dist_low (d, id, n);
+         (*len)[0] = dist_size (d, id, n);
+         runs = 1;
+      }
+      return runs;
+   }
+   for (b = id * d->block; b < n; b += d->p * d->block) {
+      if (runs && ((*start)[runs-1] + (*len)[runs-1] == b))
+         (*len)[runs-1] += MIN(d->block, n - b);
+      else {
+         (*start)[runs] = b;
+         (*len)[runs] = MIN(d->block, n - b);
+         runs++;
+      }
+   }
+   return runs;
+}
+
+
+/*
+ *   This function creates the count and displacement arrays
+ *   needed by scatter and gather functions for objects laid
+ *   out by descriptor 'd'. The elements of each process are
+ *   concatenated in rank order, each process's in increasing
+ *   order of global index.
+ */
+
+void create_dist_xfer_arrays (
+   distribution *d,       /* IN - Descriptor */
+   int           id,      /* IN - Process rank */
+   int           n,       /* IN - Number of elements */
+   int         **count,   /* OUT - Array of counts */
+   int         **disp)    /* OUT - Array of displacements */
+{
+   int i;
+
+   *count = my_malloc (id, d->p * sizeof(int));
+   *disp = my_malloc (id, d->p * sizeof(int));
+   (*count)[0] = dist_size (d, 0, n);
+   (*disp)[0] = 0;
+   for (i = 1; i < d->p; i++) {
+      (*disp)[i] = (*disp)[i-1] + (*count)[i-1];
+      (*count)[i] = dist_size (d, i, n);
+   }
+}
+
+/*
+ *   Function 'intersect_runs' finds the indices that appear
+ *   in both run lists 'a' and 'b'. It stores the common runs
+ *   in 'disp' and 'len', giving each run's position among
+ *   the elements of 'a' rather than its global index, and
+ *   returns the number of common runs.
+ */
+
+static int intersect_runs (
+   int  na,         /* IN - Runs in 'a' */
+   int *a_start,    /* IN - First index of each run of 'a' */
+   int *a_len,      /* IN - Length of each run of 'a' */
+   int  nb,         /* IN - Runs in 'b' */
+   int *b_start,    /* IN - First index of each run of 'b' */
+   int *b_len,      /* IN - Length of each run of 'b' */
+   int *disp,       /* OUT - Position of each common run */
+   int *len)        /* OUT - Length of each common run */
+{
+   int hi, lo;      /* Bounds of common run */
+   int i, j;        /* Current runs of 'a' and 'b' */
+   int k;           /* Common runs found */
+   int pos;         /* Position of run 'i' among 'a' */
+
+   i = j = k = pos = 0;
+   while ((i < na) && (j < nb)) {
+      lo = MAX(a_start[i], b_start[j]);
+      hi = MIN(a_start[i] + a_len[i], b_start[j] + b_len[j]);
+      if (lo < hi) {
+         disp[k] = pos + lo - a_start[i];
+         len[k++] = hi - lo;
+      }
+      if (a_start[i] + a_len[i] < b_start[j] + b_len[j])
+         pos += a_len[i++];
+      else j++;
+   }
+   return k;
+}
+
+
+/*
+ *   Function 'create_block_type' builds the datatype that
+ *   picks the given runs of rows and runs of cols out of a
+ *   local matrix with 'local_cols' cols. It returns 0, and
+ *   builds no type, if there are no elements to pick.
+ */
+
+static int create_block_type (
+   int           nr,          /* IN - Runs of rows */
+   int          *rdisp,       /* IN - First local row of runs */
+   int          *rlen,        /* IN - Rows in each run */
+   int           nc,          /* IN - Runs of cols */
+   int          *cdisp,       /* IN - First local col of runs */
+   int          *clen,        /* IN - Cols in each run */
+   int           local_cols,  /* IN - Cols of local matrix */
+   MPI_Datatype  dtype,       /* IN - Element type */
+   MPI_Datatype *block_type)  /* OUT - Selected elements */
+{
+   MPI_Aint     extent;       /* Extent of element */
+   MPI_Aint     lb;           /* Lower bound of element */
+   MPI_Datatype row_part;     /* Selected cols of one row */
+   MPI_Datatype row_type;     /* ... stretched to a row */
+
+   if (!nr || !nc) return 0;
+   MPI_Type_get_extent (dtype, &lb, &extent);
+   MPI_Type_indexed (nc, clen, cdisp, dtype, &row_part);
+   MPI_Type_create_resized (row_part, 0,
+      (MPI_Aint) local_cols * extent, &row_type);
+   MPI_Type_indexed (nr, rlen, rdisp, row_type, block_type);
+   MPI_Type_commit (block_type);
+   MPI_Type_free (&row_part);
+   MPI_Type_free (&row_type);
+   return 1;
+}
+
+
+/*
+ *   Function 'redistribute_matrix' moves an m x n matrix from
+ *   layout 'from' to layout 'to' without going through a
+ *   file, so a program can read a matrix with the fastest
+ *   reader and then switch to the layout that each phase
+ *   computes best in. Every pair of processes exchanges the
+ *   intersection of what one holds and the other needs, in
+ *   a single MPI_Alltoallw whose derived datatypes pick the
+ *   elements straight out of the local matrices. Both
+ *   layouts must cover all processes of 'comm'. The new
+ *   local matrix is allocated as the readers allocate theirs.
+ */
+
+void redistribute_matrix (
+   void          *src,     /* IN - Local matrix in 'from' */
+   matrix_layout *from,    /* IN - Current layout */
+   void        ***subs,    /* OUT - 2D submatrix indices */
+   void         **storage, /* OUT - Local matrix in 'to' */
+   matrix_layout *to,      /* IN - New layout */
+   MPI_Datatype   dtype,   /* IN - Element type */
+   int            m,       /* IN - Matrix rows */
+   int            n,       /* IN - Matrix cols */
+   MPI_Comm       comm)    /* IN - Communicator */
+{
+   int          *count[2];  /* Send, receive counts */
+   int           datum_size; /* Bytes per element */
+   int          *disp[2];   /* Send, receive displacements
+                               (always 0) */
+   int           i;
+   int           id;        /* Process rank */
+   matrix_layout *layout[2]; /* Layout on each side */
+   int           mc[2], mr[2]; /* Own runs of cols, rows */
+   int          *mc_len[2], *mc_start[2]; /* Own col runs */
+   int          *mr_len[2], *mr_start[2]; /* Own row runs */
+   int           local_cols; /* Cols held in 'to' */
+   int           local_rows; /* Rows held in 'to' */
+   int           nc, nr;    /* Common runs */
+   int           p;         /* Number of processes */
+   int           q;         /* Partner process */
+   int           qc, qr;    /* Partner's runs */
+   int          *qc_len, *qc_start; /* Partner's col runs */
+   int          *qr_len, *qr_start; /* Partner's row runs */
+   int          *rdisp, *rlen, *cdisp, *clen; /* Common runs */
+   MPI_Datatype *type[2];   /* Send, receive types */
+   int           t;         /* 0 to send, 1 to receive */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+   layout[0] = from;
+   layout[1] = to;
+
+   local_rows = dist_size (&to->rows, id / to->cols.p, m);
+   local_cols = dist_size (&to->cols, id % to->cols.p, n);
+   *storage = my_malloc (id,
+      (size_t) local_rows * local_cols * datum_size);
+   *subs = (void **) my_malloc (id, MAX(local_rows,1) *
+      PTR_SIZE);
+   for (i = 0; i < local_rows; i++)
+      (*subs)[i] = *storage + (size_t) i * local_cols *
+         datum_size;
+
+   /* What this process holds in each layout */
+
+   for (t = 0; t < 2; t++) {
+      mr[t] = dist_runs (&layout[t]->rows,
+         id / layout[t]->cols.p, m, &mr_start[t], &mr_len[t]);
+      mc[t] = dist_runs (&layout[t]->cols,
+         id % layout[t]->cols.p, n, &mc_start[t], &mc_len[t]);
+      count[t] = (int *) my_malloc (id, p * sizeof(int));
+      disp[t] = (int *) my_malloc (id, p * sizeof(int));
+      type[t] = (MPI_Datatype *) my_malloc (id,
+         p * sizeof(MPI_Datatype));
+   }
+   rdisp = (int *) my_malloc (id, MAX(m,1) * sizeof(int));
+   rlen = (int *) my_malloc (id, MAX(m,1) * sizeof(int));
+   cdisp = (int *) my_malloc (id, MAX(n,1) * sizeof(int));
+   clen = (int *) my_malloc (id, MAX(n,1) * sizeof(int));
+
+   /* Send to each partner what it needs in 'to' of what this
+      process holds in 'from', and receive from it what this
+      process needs in 'to' of what it holds in 'from' */
+
+   for (q = 0; q < p; q++) {
+      for (t = 0; t < 2; t++) {
+         qr = dist_runs (&layout[1-t]->rows,
+            q / layout[1-t]->cols.p, m, &qr_start, &qr_len);
+         qc = dist_runs (&layout[1-t]->cols,
+            q % layout[1-t]->cols.p, n, &qc_start, &qc_len);
+         nr = intersect_runs (mr[t], mr_start[t], mr_len[t],
+            qr, qr_start, qr_len, rdisp, rlen);
+         nc = intersect_runs (mc[t], mc_start[t], mc_len[t],
+            qc, qc_start, qc_len, cdisp, clen);
+         count[t][q] = create_block_type (nr, rdisp, rlen, nc,
+            cdisp, clen, t ? local_cols :
+            dist_size (&from->cols, id % from->cols.p, n),
+            dtype, &type[t][q]);
+         if (!count[t][q]) type[t][q] = dtype;
+         disp[t][q] = 0;
+         free (qr_start);
+         free (qr_len);
+         free (qc_start);
+         free (qc_len);
+      }
+   }
+   MPI_Alltoallw (src, count[0], disp[0], type[0], *storage,
+      count[1], disp[1], type[1], comm);
+
+   for (t = 0; t < 2; t++) {
+      for (q = 0; q < p; q++)
+         if (count[t][q]) MPI_Type_free (&type[t][q]);
+      free (mr_start[t]);
+      free (mr_len[t]);
+      free (mc_start[t]);
+      free (mc_len[t]);
+      free (count[t]);
+      free (disp[t]);
+      free (type[t]);
+   }
+   free (rdisp);
+   free (rlen);
+   free (cdisp);
+   free (clen);
+}
+
+
+/*
+ *   This function is used to transform a vector from a
+ *   block distribution to a replicated distribution within a
+ *   communicator.
+ */
+
+void replicate_block_vector (
+   void        *ablock,  /* IN - Block-distributed vector */
+   int          n,       /* IN - Elements in vector */
+   void        *arep,    /* OUT - Replicated vector */
+   MPI_Datatype dtype,   /* IN - Element type */
+   MPI_Comm     comm)    /* IN - Communicator */
+{
+   int *cnt;  /* Elements contributed by each process */
+   int *disp; /* Displacement in concatenated array */
+   int id;    /* Process id */
+   int p;     /* Processes in communicator */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   create_mixed_xfer_arrays (id, p, n, &cnt, &disp);
+   MPI_Allgatherv (ablock, cnt[id], dtype, arep, cnt,
+                   disp, dtype, comm);
+   free (cnt);
+   free (disp);
+}
+
+
+#ifdef USE_SHARED_WINDOW
+
+/*
+ *   Function 'execute_shared_replicate_plan' carries out a
+ *   hierarchical plan. Every process copies its block into
+ *   the node's shared vector, then the node leaders exchange
+ *   their nodes' blocks, so each element crosses the network
+ *   once per node instead of once per process. The barriers
+ *   keep a process from overwriting the shared vector while
+ *   others on its node may still be reading the previous
+ *   contents.
+ */
+
+static void execute_shared_replicate_plan (
+   replicate_plan *plan)  /* IN - Plan */
+{
+   int datum_size;        /* Bytes per element */
+   int i;
+   int node;              /* Rank among node leaders */
+   int p;                 /* Processes in communicator */
+   int pos;               /* Offset in 'packed' */
+   int r;                 /* Rank of block */
+
+   MPI_Comm_size (plan->comm, &p);
+   datum_size = get_size (plan->dtype);
+   MPI_Barrier (plan->node_comm);
+   memcpy (plan->arep + (size_t) plan->disp[plan->id] *
+      datum_size, plan->ablock,
+      (size_t) plan->cnt[plan->id] * datum_size);
+   MPI_Win_sync (plan->win);
+   MPI_Barrier (plan->node_comm);
+   MPI_Win_sync (plan->win);
+
+   if (plan->leader_comm != MPI_COMM_NULL) {
+      if (plan->order == NULL)
+         MPI_Allgatherv (MPI_IN_PLACE, 0, plan->dtype,
+            plan->arep, plan->node_cnt, plan->node_disp,
+            plan->dtype, plan->leader_comm);
+      else {
+
+         /* The node's blocks are not adjacent in the vector,
+            so the leaders exchange them packed */
+
+         MPI_Comm_rank (plan->leader_comm, &node);
+         for (i = pos = 0; i < p; pos += plan->cnt[r], i++) {
+            r = plan->order[i];
+            if ((pos >= plan->node_disp[node]) &&
+                (pos < plan->node_disp[node] + plan->node_cnt[node]))
+               memcpy (plan->packed + (size_t) pos * datum_size,
+                  plan->arep + (size_t) plan->disp[r] * datum_size,
+                  (size_t) plan->cnt[r] * datum_size);
+         }
+         MPI_Allgatherv (MPI_IN_PLACE, 0, plan->dtype,
+            plan->packed, plan->node_cnt, plan->node_disp,
+            plan->dtype, plan->leader_comm);
+         for (i = pos = 0; i < p; pos += plan->cnt[r], i++) {
+            r = plan->order[i];
+            memcpy (plan->arep + (size_t) plan->disp[r] * datum_size,
+               plan->packed + (size_t) pos * datum_size,
+               (size_t) plan->cnt[r] * datum_size);
+         }
+      }
+   }
+   MPI_Win_sync (plan->win);
+   MPI_Barrier (plan->node_comm);
+   MPI_Win_sync (plan->win);
+}
+
+#endif
+
+
+/*
+ *   Function 'create_replicate_plan' prepares to replicate
+ *   block-distributed vector 'ablock' into 'arep' over and
+ *   over, as an iterative solver does on every iteration.
+ *   The count and displacement arrays are built once, and
+ *   with MPI-4 the allgather itself is set up once as a
+ *   persistent collective. All processes in 'comm' must
+ *   call this function together.
+ */
+
+void create_replicate_plan (
+   void          *ablock, /* IN - Block-distributed vector */
+   int            n,      /* IN - Elements in vector */
+   void          *arep,   /* IN - Replicated vector */
+   MPI_Datatype   dtype,  /* IN - Element type */
+   MPI_Comm       comm,   /* IN - Communicator */
+   replicate_plan *plan)  /* OUT - Plan */
+{
+   int p;     /* Processes in communicator */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &plan->id);
+   plan->ablock = ablock;
+   plan->arep = arep;
+   plan->n = n;
+   plan->dtype = dtype;
+   plan->comm = comm;
+   create_mixed_xfer_arrays (plan->id, p, n, &plan->cnt,
+      &plan->disp);
+   plan->persistent = 0;
+   plan->hierarchical = 0;
+   plan->request = MPI_REQUEST_NULL;
+#ifdef USE_PERSISTENT_COLL
+   MPI_Allgatherv_init (ablock, plan->cnt[plan->id], dtype,
+      arep, plan->cnt, plan->disp, dtype, comm, MPI_INFO_NULL,
+      &plan->request);
+   plan->persistent = 1;
+#endif
+}
+
+
+/*
+ *   Function 'create_shared_replicate_plan' prepares a
+ *   hierarchical replication of 'ablock'. The processes of
+ *   each node share a single replicated vector, allocated in
+ *   an MPI-3 shared-memory window, and '*arep' is set to
+ *   point at it. Since the vector is shared, processes must
+ *   only read it between executions of the plan. Without
+ *   MPI-3 each process gets a private vector instead.
+ */
+
+void create_shared_replicate_plan (
+   void          *ablock, /* IN - Block-distributed vector */
+   int            n,      /* IN - Elements in vector */
+   void         **arep,   /* OUT - Replicated vector */
+   MPI_Datatype   dtype,  /* IN - Element type */
+   MPI_Comm       comm,   /* IN - Communicator */
+   replicate_plan *plan)  /* OUT - Plan */
+{
+   int       datum_size;  /* Bytes per element */
+   int       disp_unit;   /* Unused window property */
+   int       i, j;
+   int       leaders;     /* Number of nodes */
+   int       node;        /* Rank of node among leaders */
+   int      *node_of;     /* Node of each process */
+   int       node_id;     /* Rank on node */
+   int       p;           /* Processes in communicator */
+   MPI_Aint  size;        /* Bytes in window */
+
+#ifdef USE_SHARED_WINDOW
+   create_replicate_plan (ablock, n, NULL, dtype, comm, plan);
+   if (plan->persistent) {
+      MPI_Request_free (&plan->request);
+      plan->persistent = 0;
+   }
+   plan->hierarchical = 1;
+   MPI_Comm_size (comm, &p);
+   datum_size = get_size (dtype);
+
+   /* Group the processes by node, and the node leaders (the
+      lowest ranks on their nodes) into a communicator of
+      their own */
+
+   MPI_Comm_split_type (comm, MPI_COMM_TYPE_SHARED, plan->id,
+      MPI_INFO_NULL, &plan->node_comm);
+   MPI_Comm_rank (plan->node_comm, &node_id);
+   MPI_Comm_split (comm, node_id ? MPI_UNDEFINED : 0, plan->id,
+      &plan->leader_comm);
+   if (!node_id) {
+      MPI_Comm_size (plan->leader_comm, &leaders);
+      MPI_Comm_rank (plan->leader_comm, &node);
+   }
+   MPI_Bcast (&leaders, 1, MPI_INT, 0, plan->node_comm);
+   MPI_Bcast (&node, 1, MPI_INT, 0, plan->node_comm);
+
+   /* The leader of each node allocates the whole vector;
+      the other processes on the node map the same memory */
+
+   MPI_Win_allocate_shared (node_id ? 0 :
+      (MPI_Aint) n * datum_size, datum_size, MPI_INFO_NULL,
+      plan->node_comm, &plan->arep, &plan->win);
+   MPI_Win_shared_query (plan->win, 0, &size, &disp_unit,
+      &plan->arep);
+   MPI_Win_lock_all (MPI_MODE_NOCHECK, plan->win);
+   *arep = plan->arep;
+
+   /* Every node contributes its processes' blocks, packed in
+      rank order. If every node holds consecutive ranks, the
+      packed blocks are already in place in the vector. */
+
+   node_of = (int *) my_malloc (plan->id, p * sizeof(int));
+   MPI_Allgather (&node, 1, MPI_INT, node_of, 1, MPI_INT, comm);
+   plan->node_cnt = (int *) my_malloc (plan->id,
+      leaders * sizeof(int));
+   plan->node_disp = (int *) my_malloc (plan->id,
+      leaders * sizeof(int));
+   plan->order = (int *) my_malloc (plan->id, p * sizeof(int));
+   for (i = 0; i < leaders; i++) plan->node_cnt[i] = 0;
+   for (i = 0; i < p; i++) plan->node_cnt[node_of[i]] +=
+      plan->cnt[i];
+   plan->node_disp[0] = 0;
+   for (i = 1; i < leaders; i++)
+      plan->node_disp[i] = plan->node_disp[i-1] +
+         plan->node_cnt[i-1];
+   j = 0;
+   for (node = 0; node < leaders; node++)
+      for (i = 0; i < p; i++)
+         if (node_of[i] == node) plan->order[j++] = i;
+   for (i = 1; i < p; i++)
+      if (node_of[i] < node_of[i-1]) break;
+   if (i == p) {
+      free (plan->order);
+      plan->order = NULL;
+   }
+   plan->packed = NULL;
+   if ((plan->order != NULL) && !node_id)
+      plan->packed = my_malloc (plan->id,
+         (size_t) n * datum_size);
+   free (node_of);
+#else
+   MPI_Comm_rank (comm, &node_id);
+   *arep = my_malloc (node_id, (size_t) n * get_size (dtype));
+   create_replicate_plan (ablock, n, *arep, dtype, comm, plan);
+   plan->hierarchical = 1;
+#endif
+}
+
+
+/*
+ *   Function 'execute_replicate_plan' copies the current
+ *   contents of the plan's block-distributed vector into
+ *   its replicated vector on every process.
+ */
+
+void execute_replicate_plan (
+   replicate_plan *plan)  /* IN - Plan */
+{
+#ifdef USE_SHARED_WINDOW
+   if (plan->hierarchical) {
+      execute_shared_replicate_plan (plan);
+      return;
+   }
+#endif
+   if (plan->persistent) {
+      start_replicate_plan (plan);
+      wait_replicate_plan (plan);
+   } else
+      MPI_Allgatherv (plan->ablock, plan->cnt[plan->id],
+         plan->dtype, plan->arep, plan->cnt, plan->disp,
+         plan->dtype, plan->comm);
+}
+
+
+/*
+ *   Functions 'start_replicate_plan' and
+ *   'wait_replicate_plan' split 'execute_replicate_plan' in
+ *   two, so that the caller can compute while the vector is
+ *   in transit. Between the calls the block-distributed
+ *   vector must not be modified and the replicated vector
+ *   must not be accessed.
+ */
+
+void start_replicate_plan (
+   replicate_plan *plan)  /* IN - Plan */
+{
+   if (plan->hierarchical)
+      execute_replicate_plan (plan);
+   else if (plan->persistent)
+      MPI_Start (&plan->request);
+   else {
+#ifdef USE_NONBLOCKING_COLL
+      MPI_Iallgatherv (plan->ablock, plan->cnt[plan->id],
+         plan->dtype, plan->arep, plan->cnt, plan->disp,
+         plan->dtype, plan->comm, &plan->request);
+#else
+      MPI_Allgatherv (plan->ablock, plan->cnt[plan->id],
+         plan->dtype, plan->arep, plan->cnt, plan->disp,
+         plan->dtype, plan->comm);
+#endif
+   }
+}
+
+
+void wait_replicate_plan (
+   replicate_plan *plan)  /* IN - Plan */
+{
+   MPI_Status status;     /* Result of collective */
+
+   MPI_Wait (&plan->request, &status);
+}
+
+
+/*
+ *   Function 'free_replicate_plan' releases the resources
+ *   held by a plan. The vectors themselves are untouched.
+ */
+
+void free_replicate_plan (
+   replicate_plan *plan)  /* IN - Plan */
+{
+   if (plan->persistent)
+      MPI_Request_free (&plan->request);
+#ifdef USE_SHARED_WINDOW
+   if (plan->hierarchical) {
+      MPI_Win_unlock_all (plan->win);
+      MPI_Win_free (&plan->win);
+      if (plan->leader_comm != MPI_COMM_NULL)
+         MPI_Comm_free (&plan->leader_comm);
+      MPI_Comm_free (&plan->node_comm);
+      free (plan->node_cnt);
+      free (plan->node_disp);
+      free (plan->order);
+      free (plan->packed);
+   }
+#else
+   if (plan->hierarchical) free (plan->arep);
+#endif
+   free (plan->cnt);
+   free (plan->disp);
+}
+
+
+/*
+ *   Function 'ireplicate_block_vector' starts the same
+ *   redistribution as 'replicate_block_vector' and returns
+ *   at once. The caller may compute with anything but
+ *   'ablock' and 'arep' until 'wait_replicate', or a
+ *   'test_replicate' that returns 1, completes the transfer.
+ */
+
+void ireplicate_block_vector (
+   void        *ablock,  /* IN - Block-distributed vector */
+   int          n,       /* IN - Elements in vector */
+   void        *arep,    /* OUT - Replicated vector */
+   MPI_Datatype dtype,   /* IN - Element type */
+   MPI_Comm     comm,    /* IN - Communicator */
+   replicate_request *req) /* OUT - Transfer in progress */
+{
+   int id;    /* Process id */
+   int p;     /* Processes in communicator */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   create_mixed_xfer_arrays (id, p, n, &req->cnt, &req->disp);
+#ifdef USE_NONBLOCKING_COLL
+   MPI_Iallgatherv (ablock, req->cnt[id], dtype, arep,
+      req->cnt, req->disp, dtype, comm, &req->request);
+#else
+   MPI_Allgatherv (ablock, req->cnt[id], dtype, arep,
+      req->cnt, req->disp, dtype, comm);
+   req->request = MPI_REQUEST_NULL;
+#endif
+}
+
+
+/*
+ *   Function 'test_replicate' returns 1 if the transfer
+ *   started by 'ireplicate_block_vector' has completed, and
+ *   0 if it is still in progress. Once it returns 1 the
+ *   request must not be tested or waited on again.
+ */
+
+int test_replicate (
+   replicate_request *req) /* IN - Transfer in progress */
+{
+   int        flag;        /* Has transfer completed? */
+   MPI_Status status;      /* Result of collective */
+
+   MPI_Test (&req->request, &flag, &status);
+   if (flag) {
+      free (req->cnt);
+      free (req->disp);
+   }
+   return flag;
+}
+
+
+/*
+ *   Function 'wait_replicate' blocks until the transfer
+ *   started by 'ireplicate_block_vector' has completed.
+ */
+
+void wait_replicate (
+   replicate_request *req) /* IN - Transfer in progress */
+{
+   MPI_Status status;      /* Result of collective */
+
+   MPI_Wait (&req->request, &status);
+   free (req->cnt);
+   free (req->disp);
+}
+
+/********************* INPUT FUNCTIONS *********************/
+
+/*
+ *   Process p-1 reads the header of file 's' and broadcasts
+ *   it. The function returns 1 if the file is a compressed
+ *   file holding elements of type 'dtype', and 0 otherwise
+ *   (including when the file cannot be opened), in which case
+ *   the caller goes on to read it as an ordinary file.
+ */
+
+static int bcast_compressed_header (
+   char        *s,      /* IN - File name */
+   MPI_Datatype dtype,  /* IN - Expected element type */
+   file_header *h,      /* OUT - File header */
+   MPI_Comm     comm)   /* IN - Communicator */
+{
+   int   id;            /* Process rank */
+   FILE *infileptr;     /* Input file pointer */
+   int   p;             /* Number of processes */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   memset (h, 0, sizeof(file_header));
+   if (id == (p-1)) {
+      infileptr = fopen (s, "r");
+      if (infileptr != NULL) {
+         if (fread (h, 1, sizeof(file_header), infileptr) !=
+                sizeof(file_header))
+            h->magic = 0;
+         fclose (infileptr);
+      }
+   }
+   MPI_Bcast (h, sizeof(file_header), MPI_BYTE, p-1, comm);
+   if ((h->magic != FILE_MAGIC) || (h->codec == CODEC_NONE))
+      return 0;
+   if ((h->version != FILE_VERSION) ||
+       (h->endian != ENDIAN_MARK) ||
+       (h->type != get_type_code (dtype)) ||
+       (h->layout != LAYOUT_DENSE) ||
+       (h->chunk_rows <= 0) ||
+       (h->rows <= 0) || (h->rows > INT_MAX) ||
+       (h->cols <= 0) || (h->cols > INT_MAX)) {
+      if (!id) {
+         printf ("Error: Invalid compressed file '%s'\n", s);
+         fflush (stdout);
+      }
+      MPI_Abort (MPI_COMM_WORLD, CODEC_ERROR);
+   }
+   return 1;
+}
+
+
+/*
+ *   Function 'decompress_chunk' expands one chunk of a
+ *   compressed file, which must yield exactly 'bytes' bytes.
+ *   It returns 0 on failure, including when the library was
+ *   built without the chunk's codec.
+ */
+
+static int decompress_chunk (
+   int    codec,     /* IN - Codec of chunk */
+   void  *src,       /* IN - Compressed chunk */
+   size_t src_len,   /* IN - Bytes in 'src' */
+   void  *dst,       /* OUT - Expanded chunk */
+   size_t bytes)     /* IN - Expected bytes in 'dst' */
+{
+#ifdef HAVE_ZLIB
+   uLongf len;       /* Bytes produced by zlib */
+
+   if (codec == CODEC_ZLIB) {
+      len = bytes;
+      return (uncompress (dst, &len, src, src_len) == Z_OK) &&
+         (len == bytes);
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (codec == CODEC_ZSTD)
+      return ZSTD_decompress (dst, bytes, src, src_len) ==
+         bytes;
+#endif
+   (void) codec;
+   (void) src;
+   (void) src_len;
+   (void) dst;
+   (void) bytes;
+   return 0;
+}
+
+
+/*
+ *   Function 'read_compressed_block' fills 'storage', whose
+ *   rows are 'ld' elements apart, with rows 'row_lo' through
+ *   'row_lo'+'rows'-1 and columns 'col_lo' through
+ *   'col_lo'+'cols'-1 of the matrix held in a compressed
+ *   file. The calling process reads and expands
+ *   only the chunks that hold those rows, so that all
+ *   processes decode their parts of the file in parallel.
+ */
+
+static void read_compressed_block (
+   int          id,       /* IN - Process rank */
+   char        *s,        /* IN - File name */
+   file_header *h,        /* IN - File header */
+   int          datum_size, /* IN - Bytes per element */
+   int          row_lo,   /* IN - First row wanted */
+   int          rows,     /* IN - Rows wanted */
+   int          col_lo,   /* IN - First col wanted */
+   int          cols,     /* IN - Cols wanted */
+   int          ld,       /* IN - Elements between rows of
+                             'storage' */
+   void        *storage)  /* OUT - 'rows' x 'cols' block */
+{
+   int        c;            /* Chunk index */
+   int        c0, c1;       /* First and last chunks needed */
+   void      *chunk;        /* One expanded chunk */
+   int        chunk_lo;     /* First row of chunk */
+   int        chunk_size;   /* Rows in chunk */
+   long long *index;        /* Offsets of chunks c0..c1+1 */
+   FILE      *infileptr;    /* Input file pointer */
+   void      *packed;       /* Compressed chunks c0..c1 */
+   int        r;
+   size_t     row_bytes;    /* Bytes in a full matrix row */
+
+   if (!rows || !cols) return;
+   if ((infileptr = fopen (s, "r")) == NULL)
+      MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+
+   c0 = row_lo / h->chunk_rows;
+   c1 = (row_lo + rows - 1) / h->chunk_rows;
+   index = (long long *) my_malloc (id,
+      (c1 - c0 + 2) * sizeof(long long));
+   fseeko (infileptr, (off_t) (h->offset +
+      c0 * sizeof(long long)), SEEK_SET);
+   my_fread (id, index, sizeof(long long), c1 - c0 + 2,
+      infileptr);
+   packed = my_malloc (id, (size_t) (index[c1-c0+1] - index[0]));
+   fseeko (infileptr, (off_t) index[0], SEEK_SET);
+   my_fread (id, packed, 1, (size_t) (index[c1-c0+1] - index[0]),
+      infileptr);
+   fclose (infileptr);
+
+   row_bytes = (size_t) h->cols * datum_size;
+   chunk = my_malloc (id, h->chunk_rows * row_bytes);
+   for (c = c0; c <= c1; c++) {
+      chunk_lo = c * h->chunk_rows;
+      chunk_size = MIN(h->chunk_rows, h->rows - chunk_lo);
+      if (!decompress_chunk (h->codec,
+             packed + (index[c-c0] - index[0]),
+             (size_t) (index[c-c0+1] - index[c-c0]), chunk,
+             chunk_size * row_bytes)) {
+         printf ("Error: Cannot decode chunk %d of '%s' "
+            "on process %d\n", c, s, id);
+         fflush (stdout);
+         MPI_Abort (MPI_COMM_WORLD, CODEC_ERROR);
+      }
+      for (r = MAX(chunk_lo, row_lo);
+           r < MIN(chunk_lo + chunk_size, row_lo + rows); r++)
+         memcpy (storage + (size_t) (r - row_lo) * ld *
+            datum_size, chunk + (r - chunk_lo) * row_bytes +
+            (size_t) col_lo * datum_size,
+            (size_t) cols * datum_size);
+   }
+   free (chunk);
+   free (packed);
+   free (index);
+}
+
+
+#ifdef USE_MMAP
+
+/*
+ *   Process p-1 opens the file and reads its header, then
+ *   broadcasts the dimensions to the other processes. The
+ *   function returns the byte offset of the first element.
+ *   A file that cannot be opened yields zero dimensions.
+ */
+
+static long long bcast_file_header (
+   char        *s,      /* IN - File name */
+   int          ndims,  /* IN - 1 for a vector, 2 for a matrix */
+   MPI_Datatype dtype,  /* IN - Expected element type */
+   int         *dims,   /* OUT - Dimensions */
+   MPI_Comm     comm)   /* IN - Communicator */
+{
+   int       i;
+   int       id;         /* Process rank */
+   FILE     *infileptr;  /* Input file pointer */
+   long long offset;     /* First element */
+   int       p;          /* Number of processes */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   for (i = 0; i < ndims; i++) dims[i] = 0;
+   offset = 0;
+   if (id == (p-1)) {
+      infileptr = fopen (s, "r");
+      if (infileptr != NULL) {
+         offset = fread_header (infileptr, ndims, dtype, dims);
+         fclose (infileptr);
+      }
+   }
+   MPI_Bcast (dims, ndims, MPI_INT, p-1, comm);
+   MPI_Bcast (&offset, 1, MPI_LONG_LONG, p-1, comm);
+   return offset;
+}
+
+
+/*
+ *   Function 'map_file_range' maps 'bytes' bytes of file 's',
+ *   starting at byte 'offset', into the address space of the
+ *   calling process and returns the address of the first of
+ *   them. Pages are mapped privately, so the caller may
+ *   update the data without changing the file. The mapping
+ *   is released by 'free_storage'.
+ */
+
+static void *map_file_range (
+   int    id,       /* IN - Process rank */
+   char  *s,        /* IN - File name */
+   off_t  offset,   /* IN - First byte to map */
+   size_t bytes)    /* IN - Bytes to map */
+{
+   void    *base;   /* Start of mapping */
+   int      fd;     /* File descriptor */
+   mapping *q;      /* Record of this mapping */
+   off_t    skip;   /* Bytes between page and 'offset' */
+   struct stat st;  /* Size of file */
+
+   if (bytes == 0) return NULL;
+   skip = offset % sysconf (_SC_PAGESIZE);
+   base = MAP_FAILED;
+   if ((fd = open (s, O_RDONLY)) != -1) {
+
+      /* Touching a page past the end of the file would
+         raise SIGBUS, so a short file is caught here */
+
+      if ((fstat (fd, &st) == 0) &&
+          (st.st_size < offset + (off_t) bytes)) {
+         printf ("Error: Input file too short on process %d\n",
+            id);
+         fflush (stdout);
+         MPI_Abort (MPI_COMM_WORLD, READ_ERROR);
+      }
+      base = mmap (NULL, bytes + skip, PROT_READ | PROT_WRITE,
+         MAP_PRIVATE, fd, offset - skip);
+      close (fd);
+   }
+   if (base == MAP_FAILED) {
+      printf ("Error: Cannot map file '%s' on process %d\n",
+         s, id);
+      fflush (stdout);
+      MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+   }
+   q = (mapping *) my_malloc (id, sizeof(mapping));
+   q->data = base + skip;
+   q->base = base;
+   q->len = bytes + skip;
+   q->next = mappings;
+   mappings = q;
+   return q->data;
+}
+
+
+/*
+ *   Memory-mapped version of 'read_row_striped_matrix'. Each
+ *   process maps the bytes holding its block of rows, and
+ *   'subs' points straight into the mapping.
+ */
+
+static void mmap_read_row_striped_matrix (
+   char        *s,        /* IN - File name */
+   void      ***subs,     /* OUT - 2D submatrix indices */
+   void       **storage,  /* OUT - Submatrix stored here */
+   MPI_Datatype dtype,    /* IN - Matrix element type */
+   int         *m,        /* OUT - Matrix rows */
+   int         *n,        /* OUT - Matrix cols */
+   MPI_Comm     comm)     /* IN - Communicator */
+{
+   int       datum_size;   /* Size of matrix element */
+   int       dims[2];      /* Matrix rows and cols */
+   int       i;
+   int       id;           /* Process rank */
+   int       local_rows;   /* Rows on this proc */
+   long long offset;       /* First element in file */
+   int       p;            /* Number of processes */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+
+   offset = bcast_file_header (s, 2, dtype, dims, comm);
+   *m = dims[0];
+   *n = dims[1];
+
+   if (!(*m)) MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+
+   local_rows = BLOCK_SIZE(id,p,*m);
+   *storage = map_file_range (id, s, (off_t) offset +
+      (off_t) BLOCK_LOW(id,p,*m) * *n * datum_size,
+      (size_t) local_rows * *n * datum_size);
+   *subs = (void **) my_malloc (id, local_rows * PTR_SIZE);
+   for (i = 0; i < local_rows; i++)
+      (*subs)[i] = *storage + (size_t) i * *n * datum_size;
+   check_block (s, *storage, local_rows, *n, *n,
+      (long long) BLOCK_LOW(id,p,*m) * *n, *n, (long long) *m * *n,
+      dtype, comm);
+}
+
+
+/*
+ *   Memory-mapped version of 'read_col_striped_matrix'. Each
+ *   process maps the span of the file from its first column
+ *   of the first row to its last column of the last row.
+ *   The rows of its column block are not adjacent in the
+ *   file, so the elements may only be reached through 'subs';
+ *   '*storage' is the address of the first one.
+ */
+
+static void mmap_read_col_striped_matrix (
+   char         *s,       /* IN - File name */
+   void      ***subs,     /* OUT - 2-D array */
+   void       **storage,  /* OUT - Array elements */
+   MPI_Datatype dtype,    /* IN - Element type */
+   int         *m,        /* OUT - Rows */
+   int         *n,        /* OUT - Cols */
+   MPI_Comm     comm)     /* IN - Communicator */
+{
+   int       datum_size;   /* Size of matrix element */
+   int       dims[2];      /* Matrix rows and cols */
+   int       i;
+   int       id;           /* Process rank */
+   int       local_cols;   /* Cols on this process */
+   long long offset;       /* First element in file */
+   int       p;            /* Number of processes */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+
+   offset = bcast_file_header (s, 2, dtype, dims, comm);
+   *m = dims[0];
+   *n = dims[1];
+
+   if (!(*m)) MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+
+   local_cols = BLOCK_SIZE(id,p,*n);
+   if (local_cols)
+      *storage = map_file_range (id, s, (off_t) offset +
+         (off_t) BLOCK_LOW(id,p,*n) * datum_size,
+         ((size_t) (*m - 1) * *n + local_cols) * datum_size);
+   else *storage = NULL;
+   *subs = (void **) my_malloc (id, *m * PTR_SIZE);
+   for (i = 0; i < *m; i++)
+      (*subs)[i] = *storage + (size_t) i * *n * datum_size;
+   check_block (s, *storage, *m, local_cols, *n,
+      BLOCK_LOW(id,p,*n), *n, (long long) *m * *n, dtype,
+      comm);
+}
+
+#endif
+
+
+
+#ifdef USE_MPI_IO
+
+/*
+ *   Every process reads the header of a file opened with
+ *   MPI-IO. The function returns the byte offset of the
+ *   first element. If the header is not valid the dimensions
+ *   are set to 0.
+ */
+
+static MPI_Offset mpiio_read_header (
+   MPI_File     fh,     /* IN - Input file handle */
+   int          ndims,  /* IN - 1 for a vector, 2 for a matrix */
+   MPI_Datatype dtype,  /* IN - Expected element type */
+   int         *dims)   /* OUT - Dimensions */
+{
+   char       buf[MAX_HEADER_BYTES]; /* Start of file */
+   int        bytes;                 /* Bytes read */
+   long long  elements;              /* Elements in file */
+   int        i;
+   long long  offset;                /* First element */
+   MPI_Offset size;                  /* Bytes in file */
+   MPI_Status status;                /* Result of read */
+
+   MPI_File_read_at_all (fh, 0, buf, MAX_HEADER_BYTES,
+      MPI_BYTE, &status);
+   MPI_Get_count (&status, MPI_BYTE, &bytes);
+   offset = parse_header (buf, bytes, ndims, dtype, dims);
+   if (offset < 0)
+      for (i = 0; i < ndims; i++) dims[i] = 0;
+
+   /* A collective read does not always report that it ran
+      past the end of the file, so the size is checked here */
+
+   else {
+      MPI_File_get_size (fh, &size);
+      elements = dims[0];
+      if (ndims == 2) elements *= dims[1];
+      if (size < offset + elements * get_size (dtype)) {
+         printf ("Error: Input file too short\n");
+         fflush (stdout);
+         MPI_Abort (MPI_COMM_WORLD, READ_ERROR);
+      }
+   }
+   return (MPI_Offset) offset;
+}
+
+
+/*
+ *   Function 'mpiio_read_checkerboard_matrix' lets every
+ *   process of a two-dimensional grid read its own block of
+ *   the matrix with a single collective MPI-IO call. Each
+ *   process's file view is the subarray of the matrix that
+ *   corresponds to its grid coordinates. The function
+ *   returns 0 if MPI-IO cannot open the file, in which case
+ *   nothing has been allocated.
  */
 
-void replicate_block_vector (
-   void        *ablock,  /* IN - Block-distributed vector */
-   int          n,       /* IN - Elements in vector */
-   void        *arep,    /* OUT - Replicated vector */
+static int mpiio_read_checkerboard_matrix (
+   char *s,              /* IN - File name */
+   void ***subs,         /* OUT - 2D array */
+   void **storage,       /* OUT - Array elements */
    MPI_Datatype dtype,   /* IN - Element type */
-   MPI_Comm     comm)    /* IN - Communicator */
+   int *m,               /* OUT - Array rows */
+   int *n,               /* OUT - Array cols */
+   MPI_Comm grid_comm)   /* IN - Communicator */
 {
-   int *cnt;  /* Elements contributed by each process */
-   int *disp; /* Displacement in concatenated array */
-   int id;    /* Process id */
-   int p;     /* Processes in communicator */
+   MPI_Datatype block_type;     /* This proc's block in file */
+   int          datum_size;     /* Bytes per elements */
+   int          dims[2];        /* Matrix rows and cols */
+   MPI_File     fh;             /* Input file handle */
+   int          grid_coord[2];  /* Process coords */
+   int          grid_id;        /* Process rank */
+   int          grid_period[2]; /* Wraparound */
+   int          grid_size[2];   /* Dimensions of grid */
+   int          i;
+   int          local_cols;     /* Matrix cols on this proc */
+   int          local_rows;     /* Matrix rows on this proc */
+   MPI_Datatype local_row;      /* One row of the block */
+   MPI_Offset   offset;         /* First element in file */
+   int          rows_read;      /* Rows asked of the file */
+   int          starts[2];      /* First row and col of block */
+   MPI_Status   status;         /* Result of read */
+   int          subsizes[2];    /* Rows and cols of block */
+
+   if (MPI_File_open (grid_comm, s, MPI_MODE_RDONLY,
+          MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+      return 0;
 
-   MPI_Comm_size (comm, &p);
-   MPI_Comm_rank (comm, &id);
-   create_mixed_xfer_arrays (id, p, n, &cnt, &disp);
-   MPI_Allgatherv (ablock, cnt[id], dtype, arep, cnt,
-                   disp, dtype, comm);
-   free (cnt);
-   free (disp);
+   MPI_Comm_rank (grid_comm, &grid_id);
+   datum_size = get_size (dtype);
+
+   /* Every process reads the matrix dimensions */
+
+   offset = mpiio_read_header (fh, 2, dtype, dims);
+   *m = dims[0];
+   *n = dims[1];
+
+   if (!(*m)) MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+
+   MPI_Cart_get (grid_comm, 2, grid_size, grid_period,
+      grid_coord);
+   local_rows = BLOCK_SIZE(grid_coord[0],grid_size[0],*m);
+   local_cols = BLOCK_SIZE(grid_coord[1],grid_size[1],*n);
+
+   *storage = my_malloc (grid_id,
+      (size_t) local_rows * local_cols * datum_size);
+   *subs = (void **) my_malloc (grid_id,local_rows*PTR_SIZE);
+   for (i = 0; i < local_rows; i++)
+      (*subs)[i] = *storage + (size_t) i * local_cols * datum_size;
+
+   /* A process with an empty block still takes part in the
+      collective read, but asks for nothing: with no columns
+      its rows are empty, and it reads zero of them. The block
+      is read as 'local_rows' rows so that the count stays
+      small however large the block is. */
+
+   if (local_rows && local_cols) {
+      subsizes[0] = local_rows;
+      subsizes[1] = local_cols;
+      starts[0] = BLOCK_LOW(grid_coord[0],grid_size[0],*m);
+      starts[1] = BLOCK_LOW(grid_coord[1],grid_size[1],*n);
+      MPI_Type_create_subarray (2, dims, subsizes, starts,
+         MPI_ORDER_C, dtype, &block_type);
+   } else
+      MPI_Type_contiguous (1, dtype, &block_type);
+   MPI_Type_commit (&block_type);
+   MPI_Type_contiguous (local_cols, dtype, &local_row);
+   MPI_Type_commit (&local_row);
+   MPI_File_set_view (fh, offset, dtype, block_type,
+      "native", MPI_INFO_NULL);
+   if (!local_cols) rows_read = 0;
+   else rows_read = local_rows;
+   MPI_File_read_all (fh, *storage, rows_read, local_row,
+      &status);
+   check_read (grid_id, &status, local_row, rows_read);
+   MPI_Type_free (&local_row);
+   MPI_Type_free (&block_type);
+   MPI_File_close (&fh);
+   check_block (s, *storage, local_rows, local_cols, local_cols,
+      (long long) BLOCK_LOW(grid_coord[0],grid_size[0],*m) * *n +
+      BLOCK_LOW(grid_coord[1],grid_size[1],*n), *n,
+      (long long) *m * *n, dtype, grid_comm);
+   return 1;
 }
 
-/********************* INPUT FUNCTIONS *********************/
+#endif
+
 
 /*
  *   Function 'read_checkerboard_matrix' reads a matrix from
- *   a file. The first two elements of the file are integers
- *   whose values are the dimensions of the matrix ('m' rows
- *   and 'n' columns). What follows are 'm'*'n' values
+ *   a file. The file begins with a header holding the
+ *   dimensions of the matrix ('m' rows and 'n' columns),
+ *   either as two ints or as a versioned header with 64-bit
+ *   dimensions. What follows are 'm'*'n' values
  *   representing the matrix elements stored in row-major
  *   order.  This function allocates blocks of the matrix to
- *   the MPI processes.
+ *   the MPI processes. When MPI-IO is available every process
+ *   reads its own block; otherwise grid process 0 reads the
+ *   file a row at a time and distributes it.
  *
  *   The number of processes must be a square number.
  */
@@ -185,10 +2144,12 @@ void read_checkerboard_matrix (
                                  next row of matrix */
    int        datum_size;     /* Bytes per elements */
    int        dest_id;        /* Rank of receiving proc */
+   int        dims[2];        /* Matrix rows and cols */
    int        grid_coord[2];  /* Process coords */
    int        grid_id;        /* Process rank */
    int        grid_period[2]; /* Wraparound */
    int        grid_size[2];   /* Dimensions of grid */
+   file_header header;        /* Header of compressed file */
    int        i, j, k;
    FILE      *infileptr;      /* Input file pointer */
    void      *laddr;          /* Used when proc 0 gets row */
@@ -202,9 +2163,45 @@ void read_checkerboard_matrix (
    MPI_Status status;         /* Results of read */
 
    MPI_Comm_rank (grid_comm, &grid_id);
-   MPI_Comm_size (grid_comm, &p);
    datum_size = get_size (dtype);
 
+   /* Every process decodes its own rows of a compressed
+      file */
+
+   if (bcast_compressed_header (s, dtype, &header, grid_comm)) {
+      *m = (int) header.rows;
+      *n = (int) header.cols;
+      MPI_Cart_get (grid_comm, 2, grid_size, grid_period,
+         grid_coord);
+      local_rows = BLOCK_SIZE(grid_coord[0],grid_size[0],*m);
+      local_cols = BLOCK_SIZE(grid_coord[1],grid_size[1],*n);
+      *storage = my_malloc (grid_id,
+         (size_t) local_rows * local_cols * datum_size);
+      *subs = (void **) my_malloc (grid_id,
+         local_rows * PTR_SIZE);
+      for (i = 0; i < local_rows; i++)
+         (*subs)[i] = *storage +
+            (size_t) i * local_cols * datum_size;
+      read_compressed_block (grid_id, s, &header, datum_size,
+         BLOCK_LOW(grid_coord[0],grid_size[0],*m), local_rows,
+         BLOCK_LOW(grid_coord[1],grid_size[1],*n), local_cols,
+         local_cols, *storage);
+      check_block (s, *storage, local_rows, local_cols,
+         local_cols, (long long)
+         BLOCK_LOW(grid_coord[0],grid_size[0],*m) * *n +
+         BLOCK_LOW(grid_coord[1],grid_size[1],*n), *n,
+         (long long) *m * *n, dtype, grid_comm);
+      return;
+   }
+
+#ifdef USE_MPI_IO
+   if (mpiio_read_checkerboard_matrix (s, subs, storage, dtype,
+          m, n, grid_comm))
+      return;
+#endif
+
+   MPI_Comm_size (grid_comm, &p);
+
    /* Process 0 opens file, gets number of rows and
       number of cols, and broadcasts this information
       to the other processes. */
@@ -213,8 +2210,9 @@ void read_checkerboard_matrix (
       infileptr = fopen (s, "r");
       if (infileptr == NULL) *m = 0;
       else {
-         fread (m, sizeof(int), 1, infileptr);
-         fread (n, sizeof(int), 1, infileptr);
+         fread_header (infileptr, 2, dtype, dims);
+         *m = dims[0];
+         *n = dims[1];
       }
    }
    MPI_Bcast (m, 1, MPI_INT, 0, grid_comm);
@@ -234,7 +2232,7 @@ void read_checkerboard_matrix (
    /* Dynamically allocate two-dimensional matrix 'subs' */
 
    *storage = my_malloc (grid_id,
-      local_rows * local_cols * datum_size);
+      (size_t) local_rows * local_cols * datum_size);
    *subs = (void **) my_malloc (grid_id,local_rows*PTR_SIZE);
    lptr = (void *) *subs;
    rptr = (void *) *storage;
@@ -247,7 +2245,7 @@ void read_checkerboard_matrix (
       and distributes each row among the MPI processes. */
 
    if (grid_id == 0)
-      buffer = my_malloc (grid_id, *n * datum_size);
+      buffer = my_malloc (grid_id, (size_t) *n * datum_size);
 
    /* For each row of processes in the process grid... */
    for (i = 0; i < grid_size[0]; i++) {
@@ -259,7 +2257,8 @@ void read_checkerboard_matrix (
          /* Read in a row of the matrix */
 
          if (grid_id == 0) {
-            fread (buffer, datum_size, *n, infileptr);
+            my_fread (grid_id, buffer, datum_size, *n,
+               infileptr);
          }
 
          /* Distribute it among process in the grid row */
@@ -301,17 +2300,50 @@ void read_checkerboard_matrix (
       }
    }
    if (grid_id == 0) free (buffer);
+   check_block (s, *storage, local_rows, local_cols, local_cols,
+      (long long) BLOCK_LOW(grid_coord[0],grid_size[0],*m) * *n +
+      BLOCK_LOW(grid_coord[1],grid_size[1],*n), *n,
+      (long long) *m * *n, dtype, grid_comm);
+}
+
+
+/*
+ *   Function 'create_column_type' builds a datatype for one
+ *   column of a 'rows' x 'cols' row-major block. Its extent
+ *   is a single element, so consecutive instances of the
+ *   type are consecutive columns.
+ */
+
+static void create_column_type (
+   int           rows,      /* IN - Rows in block */
+   int           cols,      /* IN - Cols in block */
+   MPI_Datatype  dtype,     /* IN - Element type */
+   MPI_Datatype *col_type)  /* OUT - Column type */
+{
+   MPI_Aint     extent;     /* Extent of one element */
+   MPI_Aint     lb;         /* Lower bound of element */
+   MPI_Datatype strided;    /* Column before resizing */
+
+   MPI_Type_get_extent (dtype, &lb, &extent);
+   MPI_Type_vector (rows, 1, cols, dtype, &strided);
+   MPI_Type_create_resized (strided, 0, extent, col_type);
+   MPI_Type_commit (col_type);
+   MPI_Type_free (&strided);
 }
 
 
 /*
  *   Function 'read_col_striped_matrix' reads a matrix from a
- *   file.  The first two elements of the file are integers
- *   whose values are the dimensions of the matrix ('m' rows
- *   and 'n' columns).  What follows are 'm'*'n' values
+ *   file.  The file begins with a header holding the
+ *   dimensions of the matrix ('m' rows and 'n' columns),
+ *   as in 'read_checkerboard_matrix'.  What follows are
+ *   'm'*'n' values
  *   representing the matrix elements stored in row-major
  *   order.  This function allocates blocks of columns of the
- *   matrix to the MPI processes.
+ *   matrix to the MPI processes. The rows are read and
+ *   scattered in batches whose size is set by
+ *   'set_input_batch_rows'. In READ_MMAP mode every process
+ *   maps its columns instead.
  */
 
 void read_col_striped_matrix (
@@ -323,17 +2355,31 @@ void read_col_striped_matrix (
       int         *n,        /* OUT - Cols */
       MPI_Comm     comm)     /* IN - Communicator */
 {
+   int        batch;         /* Rows read at a time */
    void      *buffer;        /* File buffer */
    int        datum_size;    /* Size of matrix element */
+   int        dims[2];       /* Matrix rows and cols */
    int        i, j;
    int        id;            /* Process rank */
    FILE      *infileptr;     /* Input file ptr */
    int        local_cols;    /* Cols on this process */
    void     **lptr;          /* Pointer into 'subs' */
+   MPI_Datatype recv_type;   /* Column of local batch */
+   int        rows;          /* Rows in current batch */
    void      *rptr;          /* Pointer into 'storage' */
    int        p;             /* Number of processes */
    int       *send_count;    /* Each proc's count */
    int       *send_disp;     /* Each proc's displacement */
+   MPI_Datatype send_type;   /* Column of file batch */
+   int        type_rows;     /* Rows spanned by the types */
+
+#ifdef USE_MMAP
+   if (input_mode == READ_MMAP) {
+      mmap_read_col_striped_matrix (s, subs, storage, dtype,
+         m, n, comm);
+      return;
+   }
+#endif
 
    MPI_Comm_size (comm, &p);
    MPI_Comm_rank (comm, &id);
@@ -346,8 +2392,9 @@ void read_col_striped_matrix (
       infileptr = fopen (s, "r");
       if (infileptr == NULL) *m = 0;
       else {
-         fread (m, sizeof(int), 1, infileptr);
-         fread (n, sizeof(int), 1, infileptr);
+         fread_header (infileptr, 2, dtype, dims);
+         *m = dims[0];
+         *n = dims[1];
       }
    }
    MPI_Bcast (m, 1, MPI_INT, p-1, comm);
@@ -360,7 +2407,8 @@ void read_col_striped_matrix (
 
    /* Dynamically allocate two-dimensional matrix 'subs' */
 
-   *storage = my_malloc (id, *m * local_cols * datum_size);
+   *storage = my_malloc (id,
+      (size_t) *m * local_cols * datum_size);
    *subs = (void **) my_malloc (id, *m * PTR_SIZE);
    lptr = (void *) *subs;
    rptr = (void *) *storage;
@@ -369,29 +2417,136 @@ void read_col_striped_matrix (
       rptr += local_cols * datum_size;
    }
 
-   /* Process p-1 reads in the matrix one row at a time and
-      distributes each row among the MPI processes. */
+   /* Process p-1 reads in the matrix a batch of rows at a
+      time and distributes each batch among the MPI
+      processes with a single scatter. A process's share of
+      a batch is a set of whole columns of the batch. */
 
+   batch = input_batch_rows;
+   if (batch <= 0)
+      batch = MAX(1, DEFAULT_BATCH_BYTES / (*n * datum_size));
+   batch = MIN(batch, *m);
    if (id == (p-1))
-      buffer = my_malloc (id, *n * datum_size);
+      buffer = my_malloc (id,
+         (size_t) batch * *n * datum_size);
    create_mixed_xfer_arrays (id,p,*n,&send_count,&send_disp);
-   for (i = 0; i < *m; i++) {
+   type_rows = 0;
+   for (i = 0; i < *m; i += rows) {
+      rows = MIN(batch, *m - i);
+      if (rows != type_rows) {
+         if (type_rows) {
+            MPI_Type_free (&send_type);
+            MPI_Type_free (&recv_type);
+         }
+         create_column_type (rows, *n, dtype, &send_type);
+         create_column_type (rows, local_cols, dtype,
+            &recv_type);
+         type_rows = rows;
+      }
       if (id == (p-1))
-         fread (buffer, datum_size, *n, infileptr);
-      MPI_Scatterv (buffer, send_count, send_disp, dtype,
-         (*storage)+i*local_cols*datum_size, local_cols,
-         dtype, p-1, comm);
+         my_fread (id, buffer, datum_size, (size_t) rows * *n,
+            infileptr);
+      MPI_Scatterv (buffer, send_count, send_disp, send_type,
+         (*storage)+(size_t)i*local_cols*datum_size, local_cols,
+         recv_type, p-1, comm);
    }
+   MPI_Type_free (&send_type);
+   MPI_Type_free (&recv_type);
    free (send_count);
    free (send_disp);
-   if (id == (p-1)) free (buffer);
+   if (id == (p-1)) {
+      free (buffer);
+      fclose (infileptr);
+   }
+   check_block (s, *storage, *m, local_cols, local_cols,
+      BLOCK_LOW(id,p,*n), *n, (long long) *m * *n, dtype,
+      comm);
+}
+
+
+#ifdef USE_MPI_IO
+
+/*
+ *   Function 'mpiio_read_row_striped_matrix' lets every
+ *   process read its own block of rows straight from the
+ *   file with a collective MPI-IO call. The file view is
+ *   made of whole matrix rows, so the offset of a process's
+ *   block is simply the index of its first row. The function
+ *   returns 0 if MPI-IO cannot open the file, in which case
+ *   nothing has been allocated.
+ */
+
+static int mpiio_read_row_striped_matrix (
+   char        *s,        /* IN - File name */
+   void      ***subs,     /* OUT - 2D submatrix indices */
+   void       **storage,  /* OUT - Submatrix stored here */
+   MPI_Datatype dtype,    /* IN - Matrix element type */
+   int         *m,        /* OUT - Matrix rows */
+   int         *n,        /* OUT - Matrix cols */
+   MPI_Comm     comm)     /* IN - Communicator */
+{
+   int          datum_size;   /* Size of matrix element */
+   int          dims[2];      /* Matrix rows and cols */
+   MPI_File     fh;           /* Input file handle */
+   int          i;
+   int          id;           /* Process rank */
+   int          local_rows;   /* Rows on this proc */
+   MPI_Offset   offset;       /* First element in file */
+   int          p;            /* Number of processes */
+   MPI_Datatype row_type;     /* One matrix row */
+   MPI_Status   status;       /* Result of read */
+
+   if (MPI_File_open (comm, s, MPI_MODE_RDONLY, MPI_INFO_NULL,
+          &fh) != MPI_SUCCESS)
+      return 0;
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+
+   /* Every process reads the matrix dimensions */
+
+   offset = mpiio_read_header (fh, 2, dtype, dims);
+   *m = dims[0];
+   *n = dims[1];
+
+   if (!(*m)) MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+
+   local_rows = BLOCK_SIZE(id,p,*m);
+
+   *storage = (void *) my_malloc (id,
+       (size_t) local_rows * *n * datum_size);
+   *subs = (void **) my_malloc (id, local_rows * PTR_SIZE);
+   for (i = 0; i < local_rows; i++)
+      (*subs)[i] = *storage + (size_t) i * *n * datum_size;
+
+   /* View the data following the header as a sequence of
+      rows, then read this process's block of rows */
+
+   MPI_Type_contiguous (*n, dtype, &row_type);
+   MPI_Type_commit (&row_type);
+   MPI_File_set_view (fh, offset, row_type, row_type,
+      "native", MPI_INFO_NULL);
+   MPI_File_read_at_all (fh, BLOCK_LOW(id,p,*m), *storage,
+      local_rows, row_type, &status);
+   check_read (id, &status, row_type, local_rows);
+   MPI_Type_free (&row_type);
+   MPI_File_close (&fh);
+   check_block (s, *storage, local_rows, *n, *n,
+      (long long) BLOCK_LOW(id,p,*m) * *n, *n, (long long) *m * *n,
+      dtype, comm);
+   return 1;
 }
 
+#endif
+
 
 /*
- *   Process p-1 opens a file and inputs a two-dimensional
- *   matrix, reading and distributing blocks of rows to the
- *   other processes.
+ *   Each process inputs its block of rows of a two-dimensional
+ *   matrix stored in a file. When MPI-IO is available the
+ *   processes read their blocks collectively. Otherwise
+ *   process p-1 opens the file, reading and distributing
+ *   blocks of rows to the other processes.
  */
 
 void read_row_striped_matrix (
@@ -403,21 +2558,60 @@ void read_row_striped_matrix (
    int         *n,        /* OUT - Matrix cols */
    MPI_Comm     comm)     /* IN - Communicator */
 {
+   int          b;            /* Index of buffer in use */
+   void        *buffer[2];    /* Buffers for blocks in
+                                 transit */
    int          datum_size;   /* Size of matrix element */
+   int          dims[2];      /* Matrix rows and cols */
+   file_header  header;       /* Header of compressed file */
    int          i;
    int          id;           /* Process rank */
    FILE        *infileptr;    /* Input file pointer */
    int          local_rows;   /* Rows on this proc */
    void       **lptr;         /* Pointer into 'subs' */
    int          p;            /* Number of processes */
+   MPI_Request  req[2];       /* Sends from 'buffer' */
+   MPI_Datatype row_type;     /* One matrix row */
    void        *rptr;         /* Pointer into 'storage' */
    MPI_Status   status;       /* Result of receive */
-   int          x;            /* Result of read */
 
    MPI_Comm_size (comm, &p);
    MPI_Comm_rank (comm, &id);
    datum_size = get_size (dtype);
 
+   /* Every process decodes its own rows of a compressed
+      file */
+
+   if (bcast_compressed_header (s, dtype, &header, comm)) {
+      *m = (int) header.rows;
+      *n = (int) header.cols;
+      local_rows = BLOCK_SIZE(id,p,*m);
+      *storage = my_malloc (id,
+         (size_t) local_rows * *n * datum_size);
+      *subs = (void **) my_malloc (id, local_rows * PTR_SIZE);
+      for (i = 0; i < local_rows; i++)
+         (*subs)[i] = *storage + (size_t) i * *n * datum_size;
+      read_compressed_block (id, s, &header, datum_size,
+         BLOCK_LOW(id,p,*m), local_rows, 0, *n, *n, *storage);
+      check_block (s, *storage, local_rows, *n, *n,
+         (long long) BLOCK_LOW(id,p,*m) * *n, *n, (long long) *m * *n,
+         dtype, comm);
+      return;
+   }
+
+#ifdef USE_MMAP
+   if (input_mode == READ_MMAP) {
+      mmap_read_row_striped_matrix (s, subs, storage, dtype,
+         m, n, comm);
+      return;
+   }
+#endif
+#ifdef USE_MPI_IO
+   if (mpiio_read_row_striped_matrix (s, subs, storage, dtype,
+          m, n, comm))
+      return;
+#endif
+
    /* Process p-1 opens file, reads size of matrix,
       and broadcasts matrix dimensions to other procs */
 
@@ -425,9 +2619,10 @@ void read_row_striped_matrix (
       infileptr = fopen (s, "r");
       if (infileptr == NULL) *m = 0;
       else {
-         fread (m, sizeof(int), 1, infileptr);
-         fread (n, sizeof(int), 1, infileptr);
-      }      
+         fread_header (infileptr, 2, dtype, dims);
+         *m = dims[0];
+         *n = dims[1];
+      }
    }
    MPI_Bcast (m, 1, MPI_INT, p-1, comm);
 
@@ -441,7 +2636,7 @@ void read_row_striped_matrix (
       through 'a'. */
 
    *storage = (void *) my_malloc (id,
-       local_rows * *n * datum_size);
+       (size_t) local_rows * *n * datum_size);
    *subs = (void **) my_malloc (id, local_rows * PTR_SIZE);
 
    lptr = (void *) &(*subs[0]);
@@ -451,23 +2646,677 @@ void read_row_striped_matrix (
       rptr += *n * datum_size;
    }
 
-   /* Process p-1 reads blocks of rows from file and
-      sends each block to the correct destination process.
-      The last block it keeps. */
+   /* Process p-1 reads blocks of rows from file and
+      sends each block to the correct destination process.
+      The last block it keeps. Reads alternate between a
+      staging buffer and 'storage' (process p-1 has the
+      largest block), so that the read of one block overlaps
+      the send of the previous one. The block sent last
+      comes from the staging buffer, leaving 'storage' free
+      for the process's own rows. Blocks are sent as rows, so
+      that message counts stay small. */
+
+   MPI_Type_contiguous (*n, dtype, &row_type);
+   MPI_Type_commit (&row_type);
+   if (id == (p-1)) {
+      if (p > 1) {
+         buffer[0] = my_malloc (id,
+            (size_t) local_rows * *n * datum_size);
+         buffer[1] = *storage;
+      }
+      req[0] = req[1] = MPI_REQUEST_NULL;
+      for (i = 0; i < p-1; i++) {
+         b = (p-2-i) % 2;
+         MPI_Wait (&req[b], &status);
+         my_fread (id, buffer[b], datum_size,
+            (size_t) BLOCK_SIZE(i,p,*m) * *n, infileptr);
+         MPI_Isend (buffer[b], BLOCK_SIZE(i,p,*m), row_type,
+            i, DATA_MSG, comm, &req[b]);
+      }
+      MPI_Wait (&req[1], &status);
+      my_fread (id, *storage, datum_size,
+         (size_t) local_rows * *n, infileptr);
+      MPI_Wait (&req[0], &status);
+      if (p > 1) free (buffer[0]);
+      fclose (infileptr);
+   } else
+      MPI_Recv (*storage, local_rows, row_type, p-1,
+         DATA_MSG, comm, &status);
+   MPI_Type_free (&row_type);
+   check_block (s, *storage, local_rows, *n, *n,
+      (long long) BLOCK_LOW(id,p,*m) * *n, *n, (long long) *m * *n,
+      dtype, comm);
+}
+
+
+/*
+ *   Function 'read_row_striped_csr' reads a sparse matrix
+ *   stored in compressed sparse row form (see MyFile.h) and
+ *   gives each process a block of consecutive rows. The
+ *   blocks are chosen to balance the nonzeros rather than
+ *   the rows, so the work of a sparse matrix-vector product
+ *   is spread evenly even when the rows differ in density.
+ *   No process ever holds more than its own nonzeros and
+ *   the row pointers of the whole matrix.
+ */
+
+void read_row_striped_csr (
+   char        *s,        /* IN - File name */
+   csr_matrix  *a,        /* OUT - Local rows of matrix */
+   MPI_Datatype dtype,    /* IN - Element type */
+   MPI_Comm     comm)     /* IN - Communicator */
+{
+   long long    base;         /* First nonzero on this proc */
+   int          datum_size;   /* Size of matrix element */
+   file_header  h;            /* Header of file */
+   int          hi, lo, mid;  /* Bounds of binary search */
+   int          i;
+   int          id;           /* Process rank */
+   FILE        *infileptr;    /* Input file pointer */
+   long long    info[4];      /* Rows, cols, nonzeros and
+                                 offset, from file */
+   int          p;            /* Number of processes */
+   long long   *ptr;          /* Row pointers from file */
+   double       seconds;      /* Minus start of checksum */
+   long long    target;       /* Nonzeros before a block */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+
+   /* Process p-1 reads the header and the row pointers, and
+      picks the first row of every process's block: the
+      first row at or after its share of the nonzeros */
+
+   a->row_disp = (int *) my_malloc (id, (p+1) * sizeof(int));
+   info[0] = 0;
+   if (id == (p-1)) {
+      infileptr = fopen (s, "r");
+      if ((infileptr != NULL) &&
+          (fread (&h, sizeof(file_header), 1, infileptr) == 1) &&
+          (h.magic == FILE_MAGIC) && (h.version == FILE_VERSION) &&
+          (h.endian == ENDIAN_MARK) &&
+          (h.type == get_type_code (dtype)) &&
+          (h.layout == LAYOUT_CSR) && (h.codec == CODEC_NONE) &&
+          (h.rows > 0) && (h.rows < INT_MAX) &&
+          (h.cols > 0) && (h.cols <= INT_MAX) && (h.nnz >= 0)) {
+         ptr = (long long *) my_malloc (id,
+            (size_t) (h.rows + 1) * sizeof(long long));
+         fseeko (infileptr, (off_t) h.offset, SEEK_SET);
+         if (fread (ptr, sizeof(long long), h.rows + 1,
+                infileptr) == (size_t) (h.rows + 1)) {
+            info[0] = h.rows;
+            info[1] = h.cols;
+            info[2] = h.nnz;
+            info[3] = h.offset;
+         }
+         for (i = 0; i < p; i++) {
+            target = (long long) i * h.nnz / p;
+            lo = 0;
+            hi = (int) h.rows;
+            while (lo < hi) {
+               mid = lo + (hi - lo) / 2;
+               if (ptr[mid] < target) lo = mid + 1;
+               else hi = mid;
+            }
+            a->row_disp[i] = lo;
+         }
+         a->row_disp[p] = (int) h.rows;
+         free (ptr);
+      }
+      if (infileptr != NULL) fclose (infileptr);
+   }
+   MPI_Bcast (info, 4, MPI_LONG_LONG, p-1, comm);
+   if (!info[0]) terminate (id, "Cannot read sparse matrix file");
+   MPI_Bcast (a->row_disp, p+1, MPI_INT, p-1, comm);
+
+   a->m = (int) info[0];
+   a->n = (int) info[1];
+   a->row_cnt = (int *) my_malloc (id, p * sizeof(int));
+   for (i = 0; i < p; i++)
+      a->row_cnt[i] = a->row_disp[i+1] - a->row_disp[i];
+   a->row_lo = a->row_disp[id];
+   a->rows = a->row_cnt[id];
+
+   /* Every process reads its own row pointers, column
+      indices and values */
+
+   ptr = (long long *) my_malloc (id,
+      (a->rows + 1) * sizeof(long long));
+   if ((infileptr = fopen (s, "r")) == NULL)
+      MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+   fseeko (infileptr, (off_t) (info[3] +
+      (long long) a->row_lo * sizeof(long long)), SEEK_SET);
+   my_fread (id, ptr, sizeof(long long), a->rows + 1, infileptr);
+   base = ptr[0];
+   if (ptr[a->rows] - base > INT_MAX) {
+      printf ("Error: Too many nonzeros on process %d\n", id);
+      fflush (stdout);
+      MPI_Abort (MPI_COMM_WORLD, MALLOC_ERROR);
+   }
+   a->nnz = (int) (ptr[a->rows] - base);
+   a->row_ptr = (int *) my_malloc (id,
+      (a->rows + 1) * sizeof(int));
+   for (i = 0; i <= a->rows; i++)
+      a->row_ptr[i] = (int) (ptr[i] - base);
+   free (ptr);
+
+   a->col_idx = (int *) my_malloc (id,
+      (size_t) a->nnz * sizeof(int));
+   a->values = my_malloc (id, (size_t) a->nnz * datum_size);
+   fseeko (infileptr, (off_t) (info[3] +
+      (info[0] + 1) * sizeof(long long) +
+      base * sizeof(int)), SEEK_SET);
+   my_fread (id, a->col_idx, sizeof(int), a->nnz, infileptr);
+   fseeko (infileptr, (off_t) (info[3] +
+      (info[0] + 1) * sizeof(long long) +
+      info[2] * sizeof(int) + base * datum_size), SEEK_SET);
+   my_fread (id, a->values, datum_size, a->nnz, infileptr);
+   fclose (infileptr);
+
+   /* The checksum covers the column indices followed by the
+      values, as they lie in the file */
+
+   if (input_checksum) {
+      seconds = -MPI_Wtime();
+      report_checksum (s, crc32c_zeros (hash_block (a->col_idx,
+         1, a->nnz, 0, base, 0, info[2], sizeof(int)), info[2] *
+         datum_size) ^ hash_block (a->values, 1, a->nnz, 0, base,
+         0, info[2], datum_size), info[2] * (sizeof(int) +
+         datum_size), seconds, comm);
+   }
+}
+
+
+/*
+ *   Function 'open_everywhere' has every process open the
+ *   file and read its header, for readers in which each
+ *   process reads its own part of the file. If any process
+ *   fails, all of them terminate.
+ */
+
+static FILE *open_everywhere (
+   char         *s,       /* IN - File name */
+   int           ndims,   /* IN - 1 for a vector, 2 for a
+                             matrix */
+   MPI_Datatype  dtype,   /* IN - Element type */
+   int          *dims,    /* OUT - Dimensions */
+   long long    *offset,  /* OUT - First element in file */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   int   all_ok;          /* Could every process read? */
+   int   id;              /* Process rank */
+   FILE *infileptr;       /* Input file pointer */
+   int   ok;              /* Could this process read? */
+
+   MPI_Comm_rank (comm, &id);
+   dims[0] = 0;
+   infileptr = fopen (s, "r");
+   if (infileptr != NULL)
+      *offset = fread_header (infileptr, ndims, dtype, dims);
+   ok = (dims[0] > 0);
+   MPI_Allreduce (&ok, &all_ok, 1, MPI_INT, MPI_MIN, comm);
+   if (!all_ok) {
+      if (infileptr != NULL) fclose (infileptr);
+      terminate (id, "Cannot read input file");
+   }
+   return infileptr;
+}
+
+
+/*
+ *   Function 'read_dist_rows' lets every process read the
+ *   rows it holds under descriptor 'd' straight from the
+ *   file, one fread per run of rows. A vector is read as a
+ *   matrix with one column.
+ */
+
+static void read_dist_rows (
+   char         *s,       /* IN - File name */
+   void        **storage, /* OUT - Local rows */
+   MPI_Datatype  dtype,   /* IN - Element type */
+   int           ndims,   /* IN - 1 for a vector, 2 for a
+                             matrix */
+   int          *dims,    /* OUT - Dimensions */
+   distribution *d,       /* IN - Row distribution */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   int        cols;       /* Elements per row */
+   int        datum_size; /* Bytes per element */
+   int        i;
+   int        id;         /* Process rank */
+   FILE      *infileptr;  /* Input file pointer */
+   int       *len;        /* Length of each run */
+   long long  offset;     /* First element in file */
+   size_t     pos;        /* Elements read so far */
+   int        runs;       /* Number of runs */
+   double     seconds;    /* Minus start of checksum */
+   int       *start;      /* First row of each run */
+   unsigned int crc;      /* Share of checksum */
+
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+   infileptr = open_everywhere (s, ndims, dtype, dims, &offset,
+      comm);
+   cols = (ndims == 2) ? dims[1] : 1;
+
+   *storage = my_malloc (id, (size_t) dist_size (d, id,
+      dims[0]) * cols * datum_size);
+   runs = dist_runs (d, id, dims[0], &start, &len);
+   pos = 0;
+   for (i = 0; i < runs; i++) {
+      fseeko (infileptr, (off_t) (offset + (long long) start[i]
+         * cols * datum_size), SEEK_SET);
+      my_fread (id, *storage + pos * datum_size, datum_size,
+         (size_t) len[i] * cols, infileptr);
+      pos += (size_t) len[i] * cols;
+   }
+   fclose (infileptr);
+   if (input_checksum) {
+      seconds = -MPI_Wtime();
+      crc = 0;
+      pos = 0;
+      for (i = 0; i < runs; i++) {
+         crc ^= hash_block (*storage + pos * datum_size, len[i],
+            cols, cols, (long long) start[i] * cols, cols,
+            (long long) dims[0] * cols, datum_size);
+         pos += (size_t) len[i] * cols;
+      }
+      report_checksum (s, crc, (long long) dims[0] * cols *
+         datum_size, seconds, comm);
+   }
+   free (start);
+   free (len);
+}
+
+
+/*
+ *   Open a file containing a matrix and give each process
+ *   the rows that descriptor 'd' assigns to it.
+ */
+
+void read_dist_row_striped_matrix (
+   char         *s,       /* IN - File name */
+   void       ***subs,    /* OUT - 2D submatrix indices */
+   void        **storage, /* OUT - Submatrix stored here */
+   MPI_Datatype  dtype,   /* IN - Matrix element type */
+   int          *m,       /* OUT - Matrix rows */
+   int          *n,       /* OUT - Matrix cols */
+   distribution *d,       /* IN - Row distribution */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   int datum_size;        /* Size of matrix element */
+   int dims[2];           /* Matrix rows and cols */
+   int i;
+   int id;                /* Process rank */
+   int local_rows;        /* Rows on this proc */
+
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+   read_dist_rows (s, storage, dtype, 2, dims, d, comm);
+   *m = dims[0];
+   *n = dims[1];
+   local_rows = dist_size (d, id, *m);
+   *subs = (void **) my_malloc (id, MAX(local_rows,1) *
+      PTR_SIZE);
+   for (i = 0; i < local_rows; i++)
+      (*subs)[i] = *storage + (size_t) i * *n * datum_size;
+}
+
+
+/*
+ *   Open a file containing a vector and give each process
+ *   the elements that descriptor 'd' assigns to it.
+ */
+
+void read_dist_block_vector (
+   char         *s,       /* IN - File name */
+   void        **v,       /* OUT - Subvector */
+   MPI_Datatype  dtype,   /* IN - Element type */
+   int          *n,       /* OUT - Vector length */
+   distribution *d,       /* IN - Element distribution */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   read_dist_rows (s, v, dtype, 1, n, d, comm);
+}
+
+
+#ifdef USE_MPI_IO
+
+/*
+ *   Function 'mpiio_read_row_striped_aligned_matrix' is the
+ *   MPI-IO version of 'read_row_striped_aligned_matrix'. The
+ *   file view is made of whole matrix rows, as in
+ *   'mpiio_read_row_striped_matrix', and each row lands at
+ *   its padded place in memory through a row type whose
+ *   extent is 'ld' elements. The function returns 0 if
+ *   MPI-IO cannot open the file, in which case nothing has
+ *   been allocated.
+ */
+
+static int mpiio_read_row_striped_aligned_matrix (
+   char           *s,      /* IN - File name */
+   aligned_matrix *a,      /* OUT - Local rows */
+   MPI_Datatype    dtype,  /* IN - Matrix element type */
+   int            *m,      /* OUT - Matrix rows */
+   int            *n,      /* OUT - Matrix cols */
+   int             flags,  /* IN - ALLOC_* flags */
+   MPI_Comm        comm)   /* IN - Communicator */
+{
+   int          datum_size;   /* Size of matrix element */
+   int          dims[2];      /* Matrix rows and cols */
+   MPI_File     fh;           /* Input file handle */
+   int          id;           /* Process rank */
+   MPI_Datatype mem_row;      /* One padded row in memory */
+   MPI_Offset   offset;       /* First element in file */
+   int          p;            /* Number of processes */
+   MPI_Datatype row_type;     /* One matrix row */
+   MPI_Status   status;       /* Result of read */
+
+   if (MPI_File_open (comm, s, MPI_MODE_RDONLY, MPI_INFO_NULL,
+          &fh) != MPI_SUCCESS)
+      return 0;
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+
+   offset = mpiio_read_header (fh, 2, dtype, dims);
+   *m = dims[0];
+   *n = dims[1];
+
+   if (!(*m)) MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+
+   alloc_aligned_matrix (id, BLOCK_SIZE(id,p,*m), *n, dtype,
+      flags, a);
+
+   MPI_Type_contiguous (*n, dtype, &row_type);
+   MPI_Type_commit (&row_type);
+   MPI_Type_create_resized (row_type, 0,
+      (MPI_Aint) a->ld * datum_size, &mem_row);
+   MPI_Type_commit (&mem_row);
+   MPI_File_set_view (fh, offset, row_type, row_type,
+      "native", MPI_INFO_NULL);
+   MPI_File_read_at_all (fh, BLOCK_LOW(id,p,*m), a->base,
+      a->rows, mem_row, &status);
+   check_read (id, &status, mem_row, a->rows);
+   MPI_Type_free (&mem_row);
+   MPI_Type_free (&row_type);
+   MPI_File_close (&fh);
+   check_block (s, a->base, a->rows, *n, a->ld,
+      (long long) BLOCK_LOW(id,p,*m) * *n, *n, (long long) *m * *n,
+      dtype, comm);
+   return 1;
+}
+
+#endif
+
+
+/*
+ *   Open a file containing a matrix and give each process a
+ *   block of rows, as 'read_row_striped_matrix' does, but in
+ *   an aligned matrix allocated with 'flags'. Compressed
+ *   files, READ_MMAP mode and MPI-IO are handled as they are
+ *   there; otherwise every process reads its own rows
+ *   straight into place with 'fread'.
+ */
+
+void read_row_striped_aligned_matrix (
+   char           *s,      /* IN - File name */
+   aligned_matrix *a,      /* OUT - Local rows */
+   MPI_Datatype    dtype,  /* IN - Matrix element type */
+   int            *m,      /* OUT - Matrix rows */
+   int            *n,      /* OUT - Matrix cols */
+   int             flags,  /* IN - ALLOC_* flags */
+   MPI_Comm        comm)   /* IN - Communicator */
+{
+   int          datum_size;  /* Size of matrix element */
+   int          dims[2];     /* Matrix rows and cols */
+   file_header  header;      /* Header of compressed file */
+   int          i;
+   int          id;          /* Process rank */
+   FILE        *infileptr;   /* Input file pointer */
+   long long    offset;      /* First element in file */
+   int          p;           /* Number of processes */
+#ifdef USE_MMAP
+   void        *rows;        /* Mapped block of rows */
+#endif
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   datum_size = get_size (dtype);
+
+   /* Every process decodes its own rows of a compressed
+      file */
+
+   if (bcast_compressed_header (s, dtype, &header, comm)) {
+      *m = (int) header.rows;
+      *n = (int) header.cols;
+      alloc_aligned_matrix (id, BLOCK_SIZE(id,p,*m), *n, dtype,
+         flags, a);
+      read_compressed_block (id, s, &header, datum_size,
+         BLOCK_LOW(id,p,*m), a->rows, 0, *n, a->ld, a->base);
+      check_block (s, a->base, a->rows, *n, a->ld,
+         (long long) BLOCK_LOW(id,p,*m) * *n, *n,
+         (long long) *m * *n, dtype, comm);
+      return;
+   }
+
+#ifdef USE_MMAP
+   /* The mapping is not aligned, so its rows are copied into
+      place and it is released at once */
+
+   if (input_mode == READ_MMAP) {
+      offset = bcast_file_header (s, 2, dtype, dims, comm);
+      *m = dims[0];
+      *n = dims[1];
+      if (!(*m)) MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+      alloc_aligned_matrix (id, BLOCK_SIZE(id,p,*m), *n, dtype,
+         flags, a);
+      rows = map_file_range (id, s, (off_t) offset +
+         (off_t) BLOCK_LOW(id,p,*m) * *n * datum_size,
+         (size_t) a->rows * *n * datum_size);
+      for (i = 0; i < a->rows; i++)
+         memcpy (a->subs[i], rows + (size_t) i * *n * datum_size,
+            (size_t) *n * datum_size);
+      free_storage (rows);
+      check_block (s, a->base, a->rows, *n, a->ld,
+         (long long) BLOCK_LOW(id,p,*m) * *n, *n,
+         (long long) *m * *n, dtype, comm);
+      return;
+   }
+#endif
+#ifdef USE_MPI_IO
+   if (mpiio_read_row_striped_aligned_matrix (s, a, dtype, m, n,
+          flags, comm))
+      return;
+#endif
+
+   infileptr = open_everywhere (s, 2, dtype, dims, &offset, comm);
+   *m = dims[0];
+   *n = dims[1];
+   alloc_aligned_matrix (id, BLOCK_SIZE(id,p,*m), *n, dtype,
+      flags, a);
+   fseeko (infileptr, (off_t) (offset + (long long)
+      BLOCK_LOW(id,p,*m) * *n * datum_size), SEEK_SET);
+   if (a->ld == *n)
+      my_fread (id, a->base, datum_size, (size_t) a->rows * *n,
+         infileptr);
+   else for (i = 0; i < a->rows; i++)
+      my_fread (id, a->subs[i], datum_size, *n, infileptr);
+   fclose (infileptr);
+   check_block (s, a->base, a->rows, *n, a->ld,
+      (long long) BLOCK_LOW(id,p,*m) * *n, *n, (long long) *m * *n,
+      dtype, comm);
+}
+
+
+/*
+ *   Function 'start_block_read' begins reading the next block
+ *   of a row stream into buffer 'cur'. With MPI-IO the read
+ *   is non-blocking; otherwise it is done on the spot.
+ */
+
+static void start_block_read (
+   row_stream *rs)      /* IN/OUT - Row stream */
+{
+   long long pos;       /* Byte offset of block in file */
+
+   rs->pending = MIN(rs->block_rows, rs->rows - rs->next);
+   if (!rs->pending) return;
+   pos = rs->offset + (long long) (rs->lo + rs->next) *
+      rs->row_bytes;
+#ifdef USE_MPI_IO
+   if (rs->fp == NULL) {
+      MPI_File_iread_at (rs->fh, (MPI_Offset) pos,
+         rs->buf[rs->cur], rs->pending, rs->row_type,
+         &rs->request);
+      rs->next += rs->pending;
+      return;
+   }
+#endif
+   fseeko (rs->fp, (off_t) pos, SEEK_SET);
+   my_fread (rs->id, rs->buf[rs->cur], rs->row_bytes,
+      rs->pending, rs->fp);
+   rs->next += rs->pending;
+}
+
+
+/*
+ *   Function 'open_row_stream' opens a matrix file for
+ *   streaming. Each process will see its block of rows, as
+ *   'read_row_striped_matrix' would give it, as a sequence
+ *   of blocks of at most 'block_rows' rows, returned by
+ *   'next_row_block'. Only two blocks are ever in memory.
+ *   The first block is already being read on return.
+ */
+
+void open_row_stream (
+   char        *s,          /* IN - File name */
+   MPI_Datatype dtype,      /* IN - Matrix element type */
+   int          block_rows, /* IN - Rows per block */
+   int         *m,          /* OUT - Matrix rows */
+   int         *n,          /* OUT - Matrix cols */
+   MPI_Comm     comm,       /* IN - Communicator */
+   row_stream  *rs)         /* OUT - Row stream */
+{
+   int  b;                  /* Buffer index */
+   int  dims[2];            /* Matrix rows and cols */
+   int  i;
+   int  id;                 /* Process rank */
+   int  p;                  /* Number of processes */
+
+   MPI_Comm_size (comm, &p);
+   MPI_Comm_rank (comm, &id);
+   rs->fp = NULL;
+   rs->name = s;
+   rs->comm = comm;
+   rs->id = id;
+   rs->sum = 0;
+   rs->seconds = 0.0;
+#ifdef USE_MPI_IO
+   if (MPI_File_open (comm, s, MPI_MODE_RDONLY, MPI_INFO_NULL,
+          &rs->fh) == MPI_SUCCESS) {
+      rs->offset = mpiio_read_header (rs->fh, 2, dtype, dims);
+      if (!dims[0]) terminate (id, "Cannot read input file");
+   } else
+#endif
+   rs->fp = open_everywhere (s, 2, dtype, dims, &rs->offset,
+      comm);
+   *m = rs->m = dims[0];
+   *n = rs->n = dims[1];
+   rs->lo = BLOCK_LOW(id,p,*m);
+   rs->rows = BLOCK_SIZE(id,p,*m);
+   rs->block_rows = MAX(1, MIN(block_rows, rs->rows));
+   rs->row_bytes = (size_t) *n * get_size (dtype);
+   MPI_Type_contiguous (*n, dtype, &rs->row_type);
+   MPI_Type_commit (&rs->row_type);
+
+   for (b = 0; b < 2; b++) {
+      rs->buf[b] = my_malloc (id, rs->block_rows *
+         rs->row_bytes);
+      rs->subs[b] = (void **) my_malloc (id,
+         rs->block_rows * PTR_SIZE);
+      for (i = 0; i < rs->block_rows; i++)
+         rs->subs[b][i] = rs->buf[b] + i * rs->row_bytes;
+   }
+   rs->first = rs->next = 0;
+   rs->cur = 0;
+   start_block_read (rs);
+}
+
+
+/*
+ *   Function 'next_row_block' returns the number of rows in
+ *   the next block of the stream, or 0 once every row has
+ *   been returned, and points 'a' at them. The block's first
+ *   row is row 'rs->first' of this process's rows. Reading
+ *   the following block into the other buffer starts before
+ *   the function returns, so the rows of the previous block
+ *   must no longer be in use.
+ */
+
+int next_row_block (
+   row_stream *rs,      /* IN/OUT - Row stream */
+   void     ***a)       /* OUT - Rows of the block */
+{
+   int        rows;     /* Rows in block */
+#ifdef USE_MPI_IO
+   MPI_Status status;   /* Result of read */
+#endif
+
+   rows = rs->pending;
+   if (!rows) return 0;
+#ifdef USE_MPI_IO
+   if (rs->fp == NULL) {
+      MPI_Wait (&rs->request, &status);
+      check_read (rs->id, &status, rs->row_type, rows);
+   }
+#endif
+   *a = rs->subs[rs->cur];
+   rs->first = rs->next - rows;
+   if (input_checksum) {
+      rs->seconds -= MPI_Wtime();
+      rs->sum ^= hash_block (rs->buf[rs->cur], rows, rs->n,
+         rs->n, (long long) (rs->lo + rs->first) * rs->n, rs->n,
+         (long long) rs->m * rs->n, rs->row_bytes / rs->n);
+      rs->seconds += MPI_Wtime();
+   }
+   rs->cur ^= 1;
+   start_block_read (rs);
+   return rows;
+}
+
 
-   if (id == (p-1)) {
-      for (i = 0; i < p-1; i++) {
-         x = fread (*storage, datum_size,
-            BLOCK_SIZE(i,p,*m) * *n, infileptr);
-         MPI_Send (*storage, BLOCK_SIZE(i,p,*m) * *n, dtype,
-            i, DATA_MSG, comm);
-      }
-      x = fread (*storage, datum_size, local_rows * *n,
-         infileptr);
-      fclose (infileptr);
-   } else
-      MPI_Recv (*storage, local_rows * *n, dtype, p-1,
-         DATA_MSG, comm, &status);
+/*
+ *   Close a row stream and free its buffers. Every process
+ *   of the communicator must call it. If input checksums are
+ *   on, the checksums of the blocks are combined here, and
+ *   cover only the blocks that were returned: rows never
+ *   returned count as zeros.
+ */
+
+void close_row_stream (
+   row_stream *rs)      /* IN - Row stream */
+{
+   int        b;
+#ifdef USE_MPI_IO
+   MPI_Status status;   /* Result of read */
+
+   if (rs->fp == NULL) {
+      if (rs->pending) MPI_Wait (&rs->request, &status);
+      MPI_File_close (&rs->fh);
+   }
+#endif
+   if (rs->fp != NULL) fclose (rs->fp);
+   if (input_checksum)
+      report_checksum (rs->name, rs->sum, (long long) rs->m *
+         rs->row_bytes, -MPI_Wtime() + rs->seconds, rs->comm);
+   for (b = 0; b < 2; b++) {
+      free (rs->subs[b]);
+      free (rs->buf[b]);
+   }
+   MPI_Type_free (&rs->row_type);
 }
 
 
@@ -484,14 +3333,17 @@ void read_block_vector (
     int         *n,      /* OUT - Vector length */
     MPI_Comm     comm)   /* IN - Communicator */
 {
+   int        b;            /* Index of buffer in use */
+   void      *buffer[2];    /* Buffers for blocks in
+                               transit */
    int        datum_size;   /* Bytes per element */
    int        i;
    FILE      *infileptr;    /* Input file pointer */
    int        local_els;    /* Elements on this proc */
+   MPI_Request req[2];      /* Sends from 'buffer' */
    MPI_Status status;       /* Result of receive */
    int        id;           /* Process rank */
    int        p;            /* Number of processes */
-   int        x;            /* Result of read */
 
    datum_size = get_size (dtype);
    MPI_Comm_size(comm, &p);
@@ -504,15 +3356,10 @@ void read_block_vector (
    if (id == (p-1)) {
       infileptr = fopen (s, "r");
       if (infileptr == NULL) *n = 0;
-      else fread (n, sizeof(int), 1, infileptr);
+      else fread_header (infileptr, 1, dtype, n);
    }
    MPI_Bcast (n, 1, MPI_INT, p-1, comm);
-   if (! *n) {
-      if (!id) {
-         printf ("Input file '%s' cannot be opened\n", s);
-         fflush (stdout);
-      }
-   }
+   if (! *n) terminate (id, "Cannot open vector file");
 
    /* Block mapping of vector elements to processes */
 
@@ -520,27 +3367,46 @@ void read_block_vector (
 
    /* Dynamically allocate vector. */
 
-   *v = my_malloc (id, local_els * datum_size);
+   *v = my_malloc (id, (size_t) local_els * datum_size);
+
+   /* As in 'read_row_striped_matrix', process p-1 overlaps
+      reading each block with sending the previous one by
+      alternating between a staging buffer and '*v'. */
+
    if (id == (p-1)) {
+      if (p > 1) {
+         buffer[0] = my_malloc (id, (size_t) local_els * datum_size);
+         buffer[1] = *v;
+      }
+      req[0] = req[1] = MPI_REQUEST_NULL;
       for (i = 0; i < p-1; i++) {
-         x = fread (*v, datum_size, BLOCK_SIZE(i,p,*n),
-            infileptr);
-         MPI_Send (*v, BLOCK_SIZE(i,p,*n), dtype, i, DATA_MSG,
-            comm);
+         b = (p-2-i) % 2;
+         MPI_Wait (&req[b], &status);
+         my_fread (id, buffer[b], datum_size,
+            BLOCK_SIZE(i,p,*n), infileptr);
+         MPI_Isend (buffer[b], BLOCK_SIZE(i,p,*n), dtype, i,
+            DATA_MSG, comm, &req[b]);
       }
-      x = fread (*v, datum_size, BLOCK_SIZE(id,p,*n),
-             infileptr);
+      MPI_Wait (&req[1], &status);
+      my_fread (id, *v, datum_size, BLOCK_SIZE(id,p,*n),
+         infileptr);
+      MPI_Wait (&req[0], &status);
+      if (p > 1) free (buffer[0]);
       fclose (infileptr);
    } else {
       MPI_Recv (*v, BLOCK_SIZE(id,p,*n), dtype, p-1, DATA_MSG,
          comm, &status);
    }
+   check_block (s, *v, 1, local_els, local_els,
+      BLOCK_LOW(id,p,*n), 0, *n, dtype, comm);
 }
 
 
 /*   Open a file containing a vector, read its contents,
      and replicate the vector among all processes in a
-     communicator. */
+     communicator. In READ_MMAP mode every process maps
+     the vector instead, provided its elements are aligned
+     in the file. */
 
 void read_replicated_vector (
    char        *s,      /* IN - File name */
@@ -553,30 +3419,330 @@ void read_replicated_vector (
    int        i;
    int        id;         /* Process rank */
    FILE      *infileptr;  /* Input file pointer */
+   long long  offset;     /* First element in file */
    int        p;          /* Number of processes */
 
    MPI_Comm_rank (comm, &id);
    MPI_Comm_size (comm, &p);
    datum_size = get_size (dtype);
+   offset = 0;
    if (id == (p-1)) {
       infileptr = fopen (s, "r");
       if (infileptr == NULL) *n = 0;
-      else fread (n, sizeof(int), 1, infileptr);
+      else offset = fread_header (infileptr, 1, dtype, n);
    }
-   MPI_Bcast (n, 1, MPI_INT, p-1, MPI_COMM_WORLD);
+   MPI_Bcast (n, 1, MPI_INT, p-1, comm);
    if (! *n) terminate (id, "Cannot open vector file");
 
-   *v = my_malloc (id, *n * datum_size);
+#ifdef USE_MMAP
+   /* Map the vector only if its elements are suitably
+      aligned in the file */
+
+   if (input_mode == READ_MMAP) {
+      MPI_Bcast (&offset, 1, MPI_LONG_LONG, p-1, comm);
+      if (!(offset % datum_size)) {
+         if (id == (p-1)) fclose (infileptr);
+         *v = map_file_range (id, s, (off_t) offset,
+            (size_t) *n * datum_size);
+         check_block (s, *v + (size_t) BLOCK_LOW(id,p,*n) *
+            datum_size, 1, BLOCK_SIZE(id,p,*n), 0,
+            BLOCK_LOW(id,p,*n), 0, *n, dtype, comm);
+         return;
+      }
+   }
+#endif
+
+   *v = my_malloc (id, (size_t) *n * datum_size);
 
    if (id == (p-1)) {
-      fread (*v, datum_size, *n, infileptr);
+      my_fread (id, *v, datum_size, *n, infileptr);
       fclose (infileptr);
    }
-   MPI_Bcast (*v, *n, dtype, p-1, MPI_COMM_WORLD);
+   MPI_Bcast (*v, *n, dtype, p-1, comm);
+
+   /* Each process checksums its share of the copy */
+
+   check_block (s, *v + (size_t) BLOCK_LOW(id,p,*n) * datum_size,
+      1, BLOCK_SIZE(id,p,*n), 0, BLOCK_LOW(id,p,*n), 0, *n,
+      dtype, comm);
 }
 
 /******************** OUTPUT FUNCTIONS ********************/
 
+/*
+ *   Function 'create_stored_row_type' builds the datatype of
+ *   one row of the local matrix 'a', whose rows must be
+ *   evenly spaced in memory starting at 'a[0]', as they are
+ *   both in the matrices built by the readers and in padded
+ *   aligned matrices. If 'a' is NULL the rows are taken to
+ *   be contiguous.
+ */
+
+static void create_stored_row_type (
+   void        **a,        /* IN - 2D array, or NULL */
+   int           rows,     /* IN - Rows in 'a' */
+   int           cols,     /* IN - Cols in 'a' */
+   MPI_Datatype  dtype,    /* IN - Element type */
+   MPI_Datatype *row_type) /* OUT - One row of 'a' */
+{
+   MPI_Aint     extent;    /* Extent of element */
+   MPI_Aint     lb;        /* Lower bound of element */
+   MPI_Datatype row;       /* Contiguous row */
+
+   MPI_Type_get_extent (dtype, &lb, &extent);
+   MPI_Type_contiguous (cols, dtype, &row);
+   if ((a != NULL) && (rows > 1) &&
+       ((char *) a[1] - (char *) a[0] != cols * extent)) {
+      MPI_Type_create_resized (row, 0,
+         (char *) a[1] - (char *) a[0], row_type);
+      MPI_Type_free (&row);
+   } else
+      *row_type = row;
+   MPI_Type_commit (row_type);
+}
+
+
+/*
+ *   Text is formatted into a 'text_buffer' and written out a
+ *   chunk at a time: process 0 writes each chunk to standard
+ *   output with one fwrite, and any other process sends it to
+ *   process 0, which then only has to write it. A chunk is
+ *   flushed whenever less than FIELD_MAX bytes are left.
+ */
+
+#define TEXT_CHUNK  1048576  /* Bytes per chunk */
+#define FIELD_MAX   1024     /* Longest formatted element */
+
+typedef struct {
+   char     *buf;    /* Start of chunk */
+   char     *pos;    /* Next free byte */
+   char     *end;    /* Room for FIELD_MAX bytes ends here */
+   MPI_Comm  comm;   /* Communicator of process 0 */
+   int       id;     /* Process rank */
+} text_buffer;
+
+
+static void open_text (
+   text_buffer *t,   /* OUT - Empty buffer */
+   int          id,  /* IN - Process rank */
+   MPI_Comm     comm)/* IN - Communicator */
+{
+   t->buf = t->pos = (char *) my_malloc (id, TEXT_CHUNK);
+   t->end = t->buf + TEXT_CHUNK - FIELD_MAX;
+   t->comm = comm;
+   t->id = id;
+}
+
+
+static void flush_text (
+   text_buffer *t)   /* IN - Buffer */
+{
+   if (t->pos == t->buf) return;
+   if (!t->id) fwrite (t->buf, 1, t->pos - t->buf, stdout);
+   else MPI_Send (t->buf, t->pos - t->buf, MPI_CHAR, 0,
+           RESPONSE_MSG, t->comm);
+   t->pos = t->buf;
+}
+
+
+/* A process other than 0 ends its text with an empty
+   chunk, so process 0 knows when to stop receiving */
+
+static void close_text (
+   text_buffer *t)   /* IN - Buffer */
+{
+   flush_text (t);
+   if (t->id) MPI_Send (t->buf, 0, MPI_CHAR, 0, RESPONSE_MSG,
+                 t->comm);
+   free (t->buf);
+}
+
+
+/*
+ *   Process 0 writes the text that process 'src' formats,
+ *   chunk by chunk, until the empty chunk.
+ */
+
+static void copy_text (
+   int      src,     /* IN - Process sending text */
+   MPI_Comm comm)    /* IN - Communicator */
+{
+   char      *buf;   /* One chunk */
+   int        len;   /* Bytes in chunk */
+   MPI_Status status;/* Result of receive */
+
+   buf = (char *) my_malloc (0, TEXT_CHUNK);
+   do {
+      MPI_Recv (buf, TEXT_CHUNK, MPI_CHAR, src, RESPONSE_MSG,
+         comm, &status);
+      MPI_Get_count (&status, MPI_CHAR, &len);
+      fwrite (buf, 1, len, stdout);
+   } while (len);
+   free (buf);
+}
+
+
+/*
+ *   Function 'put_int' formats 'x' as printf's "%6lld "
+ *   would, and returns the end of the text.
+ */
+
+static char *put_int (char *out, long long x)
+{
+   char               digits[24];  /* Reversed digits */
+   int                k;           /* Digits produced */
+   unsigned long long u;           /* Magnitude of 'x' */
+
+   u = (x < 0) ? -(unsigned long long) x :
+      (unsigned long long) x;
+   k = 0;
+   do {
+      digits[k++] = '0' + (int) (u % 10);
+      u /= 10;
+   } while (u);
+   if (x < 0) digits[k++] = '-';
+   while (k < 6) digits[k++] = ' ';
+   while (k) *out++ = digits[--k];
+   *out++ = ' ';
+   return out;
+}
+
+
+/*
+ *   Function 'put_fixed' formats 'x' as printf's "%6.3f "
+ *   would, and returns the end of the text. Values too large
+ *   for exact scaled arithmetic, non-finite values and values
+ *   that come too close to halfway between two outputs are
+ *   left to snprintf, which rounds the exact binary value.
+ */
+
+static char *put_fixed (char *out, double x)
+{
+   char      digits[24];  /* Reversed digits */
+   double    frac;        /* Fraction of a thousandth */
+   int       k;           /* Characters produced */
+   int       neg;         /* Does 'x' carry a sign? */
+   long long r;           /* 'x' in thousandths */
+   double    y;           /* Magnitude of 'x' * 1000 */
+
+   neg = (x < 0.0) || ((x == 0.0) && (1.0 / x < 0.0));
+   y = (neg ? -x : x) * 1000.0;
+   if (!(y < 1.0e9))
+      return out + snprintf (out, FIELD_MAX, "%6.3f ", x);
+   r = (long long) y;
+   frac = y - (double) r;
+   if ((frac > 0.499999) && (frac < 0.500001))
+      return out + snprintf (out, FIELD_MAX, "%6.3f ", x);
+   if (frac > 0.5) r++;
+   digits[0] = '0' + (int) (r % 10);
+   digits[1] = '0' + (int) (r / 10 % 10);
+   digits[2] = '0' + (int) (r / 100 % 10);
+   digits[3] = '.';
+   k = 4;
+   r /= 1000;
+   do {
+      digits[k++] = '0' + (int) (r % 10);
+      r /= 10;
+   } while (r);
+   if (neg) digits[k++] = '-';
+   while (k < 6) digits[k++] = ' ';
+   while (k) *out++ = digits[--k];
+   *out++ = ' ';
+   return out;
+}
+
+
+static char *put_complex (char *out, dcomplex x)
+{
+   return out + snprintf (out, FIELD_MAX, "(%6.3f,%6.3f) ",
+      x.re, x.im);
+}
+
+
+/*
+ *   FORMAT_FUNCTIONS(T,ctype,PUT) defines 'format_rows_T' and
+ *   'format_elems_T', which format a matrix and a vector of
+ *   'ctype' elements with function PUT. The element type is
+ *   thus fixed at compile time, and the loops do no type
+ *   dispatch.
+ */
+
+#define FORMAT_FUNCTIONS(T,ctype,PUT)                       \
+static void format_rows_##T (text_buffer *t, void **a,      \
+   int rows, int cols)                                      \
+{                                                           \
+   int i, j;                                                \
+                                                            \
+   for (i = 0; i < rows; i++) {                             \
+      for (j = 0; j < cols; j++) {                          \
+         if (t->pos >= t->end) flush_text (t);              \
+         t->pos = PUT (t->pos, ((ctype **) a)[i][j]);       \
+      }                                                     \
+      if (t->pos >= t->end) flush_text (t);                 \
+      *t->pos++ = '\n';                                     \
+   }                                                        \
+}                                                           \
+                                                            \
+static void format_elems_##T (text_buffer *t, void *a, int n) \
+{                                                           \
+   int i;                                                   \
+                                                            \
+   for (i = 0; i < n; i++) {                                \
+      if (t->pos >= t->end) flush_text (t);                 \
+      t->pos = PUT (t->pos, ((ctype *) a)[i]);              \
+   }                                                        \
+}
+
+FORMAT_FUNCTIONS(int, int, put_int)
+FORMAT_FUNCTIONS(int64, long long, put_int)
+FORMAT_FUNCTIONS(float, float, put_fixed)
+FORMAT_FUNCTIONS(double, double, put_fixed)
+FORMAT_FUNCTIONS(complex, dcomplex, put_complex)
+
+
+static void format_submatrix (
+   text_buffer *t,       /* IN - Output buffer */
+   void       **a,       /* IN - Doubly-subscripted array */
+   MPI_Datatype dtype,   /* IN - Type of array elements */
+   int          rows,    /* IN - Matrix rows */
+   int          cols)    /* IN - Matrix cols */
+{
+   int i;
+
+   if (dtype == MPI_DOUBLE) format_rows_double (t, a, rows, cols);
+   else if (dtype == MPI_FLOAT)
+      format_rows_float (t, a, rows, cols);
+   else if (dtype == MPI_INT) format_rows_int (t, a, rows, cols);
+   else if (dtype == MPI_LONG_LONG)
+      format_rows_int64 (t, a, rows, cols);
+#ifdef HAVE_MPI_COMPLEX
+   else if (dtype == MPI_C_DOUBLE_COMPLEX)
+      format_rows_complex (t, a, rows, cols);
+#endif
+   else for (i = 0; i < rows; i++) {
+      if (t->pos >= t->end) flush_text (t);
+      *t->pos++ = '\n';
+   }
+}
+
+
+static void format_subvector (
+   text_buffer *t,       /* IN - Output buffer */
+   void        *a,       /* IN - Array pointer */
+   MPI_Datatype dtype,   /* IN - Array type */
+   int          n)       /* IN - Array size */
+{
+   if (dtype == MPI_DOUBLE) format_elems_double (t, a, n);
+   else if (dtype == MPI_FLOAT) format_elems_float (t, a, n);
+   else if (dtype == MPI_INT) format_elems_int (t, a, n);
+   else if (dtype == MPI_LONG_LONG) format_elems_int64 (t, a, n);
+#ifdef HAVE_MPI_COMPLEX
+   else if (dtype == MPI_C_DOUBLE_COMPLEX)
+      format_elems_complex (t, a, n);
+#endif
+}
+
+
 /*
  *   Print elements of a doubly-subscripted array.
  */
@@ -587,21 +3753,12 @@ void print_submatrix (
    int          rows,    /* OUT - Matrix rows */
    int          cols)    /* OUT - Matrix cols */
 {
-   int i, j;
+   text_buffer t;        /* Formatted rows */
 
-   for (i = 0; i < rows; i++) {
-      for (j = 0; j < cols; j++) {
-         if (dtype == MPI_DOUBLE)
-            printf ("%6.3f ", ((double **)a)[i][j]);
-         else {
-            if (dtype == MPI_FLOAT)
-               printf ("%6.3f ", ((float **)a)[i][j]);
-            else if (dtype == MPI_INT)
-               printf ("%6d ", ((int **)a)[i][j]);
-         }
-      }
-      putchar ('\n');
-   }
+   open_text (&t, 0, MPI_COMM_WORLD);
+   format_submatrix (&t, a, dtype, rows, cols);
+   flush_text (&t);
+   free (t.buf);
 }
 
 
@@ -614,18 +3771,12 @@ void print_subvector (
    MPI_Datatype dtype,   /* IN - Array type */
    int          n)       /* IN - Array size */
 {
-   int i;
+   text_buffer t;        /* Formatted elements */
 
-   for (i = 0; i < n; i++) {
-      if (dtype == MPI_DOUBLE)
-         printf ("%6.3f ", ((double *)a)[i]);
-      else {
-         if (dtype == MPI_FLOAT)
-            printf ("%6.3f ", ((float *)a)[i]);
-         else if (dtype == MPI_INT)
-            printf ("%6d ", ((int *)a)[i]);
-      }
-   }
+   open_text (&t, 0, MPI_COMM_WORLD);
+   format_subvector (&t, a, dtype, n);
+   flush_text (&t);
+   free (t.buf);
 }
 
 
@@ -656,6 +3807,7 @@ void print_checkerboard_matrix (
    int        p;              /* Number of processes */
    int        src;            /* ID of proc with subrow */
    MPI_Status status;         /* Result of receive */
+   text_buffer t;             /* Formatted rows */
 
    MPI_Comm_rank (grid_comm, &grid_id);
    MPI_Comm_size (grid_comm, &p);
@@ -665,8 +3817,10 @@ void print_checkerboard_matrix (
       grid_coords);
    local_cols = BLOCK_SIZE(grid_coords[1],grid_size[1],n);
 
-   if (!grid_id)
-      buffer = my_malloc (grid_id, n*datum_size);
+   if (!grid_id) {
+      buffer = my_malloc (grid_id, (size_t) n * datum_size);
+      open_text (&t, grid_id, grid_comm);
+   }
 
    /* For each row of the process grid */
    for (i = 0; i < grid_size[0]; i++) {
@@ -691,8 +3845,8 @@ void print_checkerboard_matrix (
                      grid_comm, &status);
                }
             }
-            print_subvector (buffer, dtype, n);
-            putchar ('\n');
+            format_subvector (&t, buffer, dtype, n);
+            *t.pos++ = '\n';
          } else if (grid_coords[0] == i) {
             MPI_Send (a[j], local_cols, dtype, 0, 0,
                grid_comm);
@@ -701,7 +3855,8 @@ void print_checkerboard_matrix (
    }
    if (!grid_id) {
       free (buffer);
-      putchar ('\n');
+      *t.pos++ = '\n';
+      close_text (&t);
    }
 }
 
@@ -726,28 +3881,32 @@ void print_col_striped_matrix (
    int        p;          /* Number of processes */
    int*       rec_count;  /* Elements received per proc */
    int*       rec_disp;   /* Offset of each proc's block */
+   text_buffer t;         /* Formatted rows */
 
    MPI_Comm_rank (comm, &id);
    MPI_Comm_size (comm, &p);
    datum_size = get_size (dtype);
    create_mixed_xfer_arrays (id, p, n, &rec_count,&rec_disp);
 
-   if (!id)
-      buffer = my_malloc (id, n*datum_size);
+   if (!id) {
+      buffer = my_malloc (id, (size_t) n * datum_size);
+      open_text (&t, id, comm);
+   }
 
    for (i = 0; i < m; i++) {
       MPI_Gatherv (a[i], BLOCK_SIZE(id,p,n), dtype, buffer,
          rec_count, rec_disp, dtype, 0, MPI_COMM_WORLD);
       if (!id) {
-         print_subvector (buffer, dtype, n);
-         putchar ('\n');
+         format_subvector (&t, buffer, dtype, n);
+         *t.pos++ = '\n';
       }
    }
    free (rec_count);
    free (rec_disp);
    if (!id) {
       free (buffer);
-      putchar ('\n');
+      *t.pos++ = '\n';
+      close_text (&t);
    }
 }
 
@@ -764,53 +3923,148 @@ void print_row_striped_matrix (
    int n,               /* IN - Matrix cols */
    MPI_Comm comm)       /* IN - Communicator */
 {
-   MPI_Status  status;          /* Result of receive */
-   void       *bstorage;        /* Elements received from
-                                   another process */
-   void      **b;               /* 2D array indexing into
-                                   'bstorage' */
-   int         datum_size;      /* Bytes per element */
    int         i;
    int         id;              /* Process rank */
-   int         local_rows;      /* This proc's rows */
-   int         max_block_size;  /* Most matrix rows held by
-                                   any process */
-   int         prompt;          /* Dummy variable */
    int         p;               /* Number of processes */
+   text_buffer t;               /* Formatted rows */
 
    MPI_Comm_rank (comm, &id);
    MPI_Comm_size (comm, &p);
-   local_rows = BLOCK_SIZE(id,p,m);
+
+   /* Every process formats its own rows; process 0 writes
+      its text and then that of each other process in turn */
+
+   open_text (&t, id, comm);
+   format_submatrix (&t, a, dtype, BLOCK_SIZE(id,p,m), n);
    if (!id) {
-      print_submatrix (a, dtype, local_rows, n);
-      if (p > 1) {
-         datum_size = get_size (dtype);
-         max_block_size = BLOCK_SIZE(p-1,p,m);
-         bstorage = my_malloc (id,
-            max_block_size * n * datum_size);
-         b = (void **) my_malloc (id,
-            max_block_size * datum_size);
-         b[0] = bstorage;
-         for (i = 1; i < max_block_size; i++) {
-            b[i] = b[i-1] + n * datum_size;
-         }
-         for (i = 1; i < p; i++) {
-            MPI_Send (&prompt, 1, MPI_INT, i, PROMPT_MSG,
-               MPI_COMM_WORLD);
-            MPI_Recv (bstorage, BLOCK_SIZE(i,p,m)*n, dtype,
-               i, RESPONSE_MSG, MPI_COMM_WORLD, &status);
-            print_submatrix (b, dtype, BLOCK_SIZE(i,p,m), n);
+      flush_text (&t);
+      for (i = 1; i < p; i++) copy_text (i, comm);
+      putchar ('\n');
+   }
+   close_text (&t);
+}
+
+
+/*
+ *   Function 'print_dist_rows' prints the rows of a matrix
+ *   (or the elements of a vector) laid out by descriptor 'd'.
+ *   Process 0 walks the rows in order; each maximal run of
+ *   rows held by another process is fetched with one
+ *   prompt/response exchange, which matches that process's
+ *   own list of runs from 'dist_runs'.
+ */
+
+static void print_dist_rows (
+   void        **a,       /* IN - Local rows, or NULL for a
+                             vector */
+   void         *v,       /* IN - First local element */
+   MPI_Datatype  dtype,   /* IN - Element type */
+   int           m,       /* IN - Rows, or vector length */
+   int           n,       /* IN - Cols, or 1 */
+   distribution *d,       /* IN - Row distribution */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   void       **b;        /* Pointers to received rows */
+   void        *buffer;   /* Rows from another process */
+   int          datum_size; /* Bytes per element */
+   int          i;
+   int          id;       /* Process rank */
+   int         *len;      /* Length of each local run */
+   int          max_rows; /* Most rows held by a process */
+   int          owner;    /* Process holding current run */
+   int          p;        /* Number of processes */
+   size_t       pos;      /* Local rows printed or sent */
+   int          prompt;   /* Dummy variable */
+   int          r;        /* First row of current run */
+   int          rows;     /* Rows in current run */
+   MPI_Datatype row_type; /* One matrix row */
+   int          runs;     /* Number of local runs */
+   int         *start;    /* First row of each local run */
+   MPI_Status   status;   /* Result of receive */
+
+   MPI_Comm_rank (comm, &id);
+   MPI_Comm_size (comm, &p);
+   datum_size = get_size (dtype);
+   MPI_Type_contiguous (n, dtype, &row_type);
+   MPI_Type_commit (&row_type);
+   pos = 0;
+   if (!id) {
+      max_rows = 1;
+      for (i = 1; i < p; i++)
+         max_rows = MAX(max_rows, dist_size (d, i, m));
+      buffer = my_malloc (id, (size_t) max_rows * n * datum_size);
+      b = (void **) my_malloc (id, max_rows * PTR_SIZE);
+      for (i = 0; i < max_rows; i++)
+         b[i] = buffer + (size_t) i * n * datum_size;
+      for (r = 0; r < m; r += rows) {
+         owner = dist_owner (d, r, m);
+         for (rows = 1; (r + rows < m) &&
+              (dist_owner (d, r + rows, m) == owner); rows++);
+         if (!owner) {
+            if (a == NULL)
+               print_subvector (v + pos * datum_size, dtype,
+                  rows);
+            else print_submatrix (a + pos, dtype, rows, n);
+            pos += rows;
+         } else {
+            MPI_Send (&prompt, 1, MPI_INT, owner, PROMPT_MSG,
+               comm);
+            MPI_Recv (buffer, rows, row_type, owner,
+               RESPONSE_MSG, comm, &status);
+            if (a == NULL) print_subvector (buffer, dtype, rows);
+            else print_submatrix (b, dtype, rows, n);
          }
-         free (b);
-         free (bstorage);
       }
-      putchar ('\n');
+      free (b);
+      free (buffer);
+      if (a == NULL) printf ("\n\n");
+      else putchar ('\n');
    } else {
-      MPI_Recv (&prompt, 1, MPI_INT, 0, PROMPT_MSG,
-         MPI_COMM_WORLD, &status);
-      MPI_Send (*a, local_rows * n, dtype, 0, RESPONSE_MSG,
-         MPI_COMM_WORLD);
+      runs = dist_runs (d, id, m, &start, &len);
+      for (i = 0; i < runs; i++) {
+         MPI_Recv (&prompt, 1, MPI_INT, 0, PROMPT_MSG, comm,
+            &status);
+         MPI_Send (v + pos * n * datum_size, len[i], row_type,
+            0, RESPONSE_MSG, comm);
+         pos += len[i];
+      }
+      free (start);
+      free (len);
    }
+   MPI_Type_free (&row_type);
+}
+
+
+/*
+ *   Print a matrix whose rows are distributed among the
+ *   processes in a communicator by descriptor 'd'.
+ */
+
+void print_dist_row_striped_matrix (
+   void        **a,       /* IN - 2D array */
+   MPI_Datatype  dtype,   /* IN - Matrix element type */
+   int           m,       /* IN - Matrix rows */
+   int           n,       /* IN - Matrix cols */
+   distribution *d,       /* IN - Row distribution */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   print_dist_rows (a, *a, dtype, m, n, d, comm);
+}
+
+
+/*
+ *   Print a vector whose elements are distributed among the
+ *   processes in a communicator by descriptor 'd'.
+ */
+
+void print_dist_block_vector (
+   void         *v,       /* IN - Address of vector */
+   MPI_Datatype  dtype,   /* IN - Vector element type */
+   int           n,       /* IN - Elements in vector */
+   distribution *d,       /* IN - Element distribution */
+   MPI_Comm      comm)    /* IN - Communicator */
+{
+   print_dist_rows (NULL, v, dtype, n, 1, d, comm);
 }
 
 
@@ -825,38 +4079,22 @@ void print_block_vector (
    int          n,       /* IN - Elements in vector */
    MPI_Comm     comm)    /* IN - Communicator */
 {
-   int        datum_size; /* Bytes per vector element */
-   int        i;
-   int        prompt;     /* Dummy variable */
-   MPI_Status status;     /* Result of receive */
-   void       *tmp;       /* Other process's subvector */
-   int        id;         /* Process rank */
-   int        p;          /* Number of processes */
+   int         i;
+   int         id;        /* Process rank */
+   int         p;         /* Number of processes */
+   text_buffer t;         /* Formatted elements */
 
    MPI_Comm_size (comm, &p);
    MPI_Comm_rank (comm, &id);
-   datum_size = get_size (dtype);
 
+   open_text (&t, id, comm);
+   format_subvector (&t, v, dtype, BLOCK_SIZE(id,p,n));
    if (!id) {
-      print_subvector (v, dtype, BLOCK_SIZE(id,p,n));
-      if (p > 1) {
-         tmp = my_malloc (id,BLOCK_SIZE(p-1,p,n)*datum_size);
-         for (i = 1; i < p; i++) {
-            MPI_Send (&prompt, 1, MPI_INT, i, PROMPT_MSG,
-               comm);
-            MPI_Recv (tmp, BLOCK_SIZE(i,p,n), dtype, i,
-               RESPONSE_MSG, comm, &status);
-            print_subvector (tmp, dtype, BLOCK_SIZE(i,p,n));
-         }
-         free (tmp);
-      }
+      flush_text (&t);
+      for (i = 1; i < p; i++) copy_text (i, comm);
       printf ("\n\n");
-   } else {
-      MPI_Recv (&prompt, 1, MPI_INT, 0, PROMPT_MSG, comm,
-         &status);
-      MPI_Send (v, BLOCK_SIZE(id,p,n), dtype, 0,
-         RESPONSE_MSG, comm);
    }
+   close_text (&t);
 }
 
 
@@ -880,3 +4118,250 @@ void print_replicated_vector (
       printf ("\n\n");
    }
 }
+
+
+/*
+ *   Function 'open_output_file' creates (or truncates) file
+ *   's' for collective writing by the processes in 'comm',
+ *   and has process 0 write a versioned header for a 'rows'
+ *   x 'cols' array of 'dtype' elements. It returns the byte
+ *   offset at which the elements belong.
+ */
+
+#ifdef USE_MPI_IO
+
+static MPI_Offset open_output_file (
+   char        *s,      /* IN - File name */
+   MPI_Datatype dtype,  /* IN - Element type */
+   int          rows,   /* IN - Rows, or vector length */
+   int          cols,   /* IN - Cols, or 1 */
+   MPI_File    *fh,     /* OUT - Output file handle */
+   MPI_Comm     comm)   /* IN - Communicator */
+{
+   file_header h;       /* File header */
+   int         id;      /* Process rank */
+   MPI_Status  status;  /* Result of write */
+
+   MPI_Comm_rank (comm, &id);
+   if (MPI_File_open (comm, s, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+          MPI_INFO_NULL, fh) != MPI_SUCCESS) {
+      if (!id) {
+         printf ("Error: Cannot create file '%s'\n", s);
+         fflush (stdout);
+      }
+      MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+   }
+   MPI_File_set_size (*fh, 0);
+   fill_header (&h, dtype, rows, cols);
+   if (!id)
+      MPI_File_write_at (*fh, 0, &h, sizeof(file_header),
+         MPI_BYTE, &status);
+   return (MPI_Offset) h.offset;
+}
+
+#else
+
+/* Without MPI-IO the writers cannot run */
+
+static long long open_output_file (char *s, MPI_Datatype dtype,
+   int rows, int cols, void *fh, MPI_Comm comm)
+{
+   int id;
+
+   MPI_Comm_rank (comm, &id);
+   if (!id) {
+      printf ("Error: Writing '%s' requires MPI-IO\n", s);
+      fflush (stdout);
+   }
+   MPI_Abort (MPI_COMM_WORLD, OPEN_FILE_ERROR);
+   return 0;
+}
+
+#endif
+
+
+/*
+ *   Write a matrix distributed checkerboard fashion among the
+ *   processes in a communicator to a file, in the format read
+ *   by 'read_checkerboard_matrix'. The rows of each
+ *   process's block must be evenly spaced, starting at
+ *   'a[0]'.
+ */
+
+void write_checkerboard_matrix (
+   char        *s,            /* IN - File name */
+   void       **a,            /* IN - 2D matrix */
+   MPI_Datatype dtype,        /* IN - Matrix element type */
+   int          m,            /* IN - Matrix rows */
+   int          n,            /* IN - Matrix columns */
+   MPI_Comm     grid_comm)    /* IN - Communicator */
+{
+   int          dims[2];        /* Matrix rows and cols */
+   int          grid_coords[2]; /* Coords of this process */
+   int          grid_period[2]; /* Wraparound */
+   int          grid_size[2];   /* Dims of process grid */
+   int          local_cols;     /* Matrix cols on this proc */
+   int          local_rows;     /* Matrix rows on this proc */
+   long long    offset;         /* First element in file */
+#ifdef USE_MPI_IO
+   MPI_Datatype block_type;     /* This proc's block in file */
+   MPI_File     fh;             /* Output file handle */
+   MPI_Datatype local_row;      /* One row of the block */
+   int          starts[2];      /* First row and col of block */
+   MPI_Status   status;         /* Result of write */
+   int          subsizes[2];    /* Rows and cols of block */
+#else
+   void        *fh;
+#endif
+
+   dims[0] = m;
+   dims[1] = n;
+   offset = open_output_file (s, dtype, m, n, &fh, grid_comm);
+
+#ifdef USE_MPI_IO
+   MPI_Cart_get (grid_comm, 2, grid_size, grid_period,
+      grid_coords);
+   local_rows = BLOCK_SIZE(grid_coords[0],grid_size[0],m);
+   local_cols = BLOCK_SIZE(grid_coords[1],grid_size[1],n);
+   if (local_rows && local_cols) {
+      subsizes[0] = local_rows;
+      subsizes[1] = local_cols;
+      starts[0] = BLOCK_LOW(grid_coords[0],grid_size[0],m);
+      starts[1] = BLOCK_LOW(grid_coords[1],grid_size[1],n);
+      MPI_Type_create_subarray (2, dims, subsizes, starts,
+         MPI_ORDER_C, dtype, &block_type);
+   } else
+      MPI_Type_contiguous (1, dtype, &block_type);
+   MPI_Type_commit (&block_type);
+   create_stored_row_type (a, local_rows, local_cols, dtype,
+      &local_row);
+   MPI_File_set_view (fh, offset, dtype, block_type,
+      "native", MPI_INFO_NULL);
+   MPI_File_write_all (fh, local_rows ? a[0] : NULL,
+      local_rows, local_row, &status);
+   MPI_Type_free (&local_row);
+   MPI_Type_free (&block_type);
+   MPI_File_close (&fh);
+#endif
+}
+
+
+/*
+ *   Write a matrix that is distributed in row-striped
+ *   fashion among the processes in a communicator to a file,
+ *   in the format read by 'read_row_striped_matrix'. Each
+ *   process's rows must be evenly spaced, starting at
+ *   'a[0]', as in an aligned matrix.
+ */
+
+void write_row_striped_matrix (
+   char        *s,       /* IN - File name */
+   void       **a,       /* IN - 2D array */
+   MPI_Datatype dtype,   /* IN - Matrix element type */
+   int          m,       /* IN - Matrix rows */
+   int          n,       /* IN - Matrix cols */
+   MPI_Comm     comm)    /* IN - Communicator */
+{
+   int          id;         /* Process rank */
+   int          local_rows; /* This proc's rows */
+   long long    offset;     /* First element in file */
+   int          p;          /* Number of processes */
+#ifdef USE_MPI_IO
+   MPI_File     fh;         /* Output file handle */
+   MPI_Datatype local_row;  /* One row in memory */
+   MPI_Datatype row_type;   /* One matrix row */
+   MPI_Status   status;     /* Result of write */
+#else
+   void        *fh;
+#endif
+
+   offset = open_output_file (s, dtype, m, n, &fh, comm);
+
+#ifdef USE_MPI_IO
+   MPI_Comm_rank (comm, &id);
+   MPI_Comm_size (comm, &p);
+   local_rows = BLOCK_SIZE(id,p,m);
+   MPI_Type_contiguous (n, dtype, &row_type);
+   MPI_Type_commit (&row_type);
+   create_stored_row_type (a, local_rows, n, dtype, &local_row);
+   MPI_File_set_view (fh, offset, row_type, row_type,
+      "native", MPI_INFO_NULL);
+   MPI_File_write_at_all (fh, BLOCK_LOW(id,p,m),
+      local_rows ? a[0] : NULL, local_rows, local_row, &status);
+   MPI_Type_free (&local_row);
+   MPI_Type_free (&row_type);
+   MPI_File_close (&fh);
+#endif
+}
+
+
+/*
+ *   Write a vector that is block distributed among the
+ *   processes in a communicator to a file, in the format
+ *   read by 'read_block_vector'.
+ */
+
+void write_block_vector (
+   char        *s,       /* IN - File name */
+   void        *v,       /* IN - Address of vector */
+   MPI_Datatype dtype,   /* IN - Vector element type */
+   int          n,       /* IN - Elements in vector */
+   MPI_Comm     comm)    /* IN - Communicator */
+{
+   int          id;      /* Process rank */
+   long long    offset;  /* First element in file */
+   int          p;       /* Number of processes */
+#ifdef USE_MPI_IO
+   MPI_File     fh;      /* Output file handle */
+   MPI_Status   status;  /* Result of write */
+#else
+   void        *fh;
+#endif
+
+   offset = open_output_file (s, dtype, n, 1, &fh, comm);
+
+#ifdef USE_MPI_IO
+   MPI_Comm_rank (comm, &id);
+   MPI_Comm_size (comm, &p);
+   MPI_File_set_view (fh, offset, dtype, dtype,
+      "native", MPI_INFO_NULL);
+   MPI_File_write_at_all (fh, BLOCK_LOW(id,p,n), v,
+      BLOCK_SIZE(id,p,n), dtype, &status);
+   MPI_File_close (&fh);
+#endif
+}
+
+
+/*
+ *   Write a vector that is replicated among the processes
+ *   in a communicator to a file, in the format read by
+ *   'read_replicated_vector'. Process 0 writes the data.
+ */
+
+void write_replicated_vector (
+   char        *s,      /* IN - File name */
+   void        *v,      /* IN - Address of vector */
+   MPI_Datatype dtype,  /* IN - Vector element type */
+   int          n,      /* IN - Elements in vector */
+   MPI_Comm     comm)   /* IN - Communicator */
+{
+   int          id;     /* Process rank */
+   long long    offset; /* First element in file */
+#ifdef USE_MPI_IO
+   MPI_File     fh;     /* Output file handle */
+   MPI_Status   status; /* Result of write */
+#else
+   void        *fh;
+#endif
+
+   offset = open_output_file (s, dtype, n, 1, &fh, comm);
+
+#ifdef USE_MPI_IO
+   MPI_Comm_rank (comm, &id);
+   MPI_File_set_view (fh, offset, dtype, dtype,
+      "native", MPI_INFO_NULL);
+   MPI_File_write_at_all (fh, 0, v, id ? 0 : n, dtype,
+      &status);
+   MPI_File_close (&fh);
+#endif
+}
@@ -8,6 +8,8 @@
  *   Last modification: 4 September 2002
  */
 
+#include "MyFile.h"
+
 /************************* MACROS **************************/
 
 #define DATA_MSG           0
@@ -17,24 +19,217 @@
 #define OPEN_FILE_ERROR    -1
 #define MALLOC_ERROR       -2
 #define TYPE_ERROR         -3
+#define CODEC_ERROR        -4
+#define READ_ERROR         -5
+
+#define READ_COPY          0
+#define READ_MMAP          1
+
+#define DEFAULT_BATCH_BYTES 1048576
+
+#define ALIGN_BYTES        64
+#define ALLOC_HUGE_PAGES   1
+#define ALLOC_FIRST_TOUCH  2
+
+#define DIST_BLOCK         0
+#define DIST_CYCLIC        1
+#define DIST_BLOCK_CYCLIC  2
+#define DIST_WEIGHTED      3
 
 #define MIN(a,b)           ((a)<(b)?(a):(b))
-#define BLOCK_LOW(id,p,n)  ((id)*(n)/(p))
+#define MAX(a,b)           ((a)>(b)?(a):(b))
+
+/* The products in these macros are formed in 64 bits, so
+   they do not overflow even when 'id'*'n' exceeds INT_MAX */
+
+#define BLOCK_LOW(id,p,n)  ((int)((long long)(id)*(n)/(p)))
 #define BLOCK_HIGH(id,p,n) (BLOCK_LOW((id)+1,p,n)-1)
 #define BLOCK_SIZE(id,p,n) \
                      (BLOCK_HIGH(id,p,n)-BLOCK_LOW(id,p,n)+1)
-#define BLOCK_OWNER(j,p,n) (((p)*((j)+1)-1)/(n))
+#define BLOCK_OWNER(j,p,n) \
+                     ((int)(((long long)(p)*((j)+1)-1)/(n)))
 #define PTR_SIZE           (sizeof(void*))
 #define CEILING(i,j)       (((i)+(j)-1)/(j))
 
+/************************* TYPES ***************************/
+
+/* A local matrix whose rows each start on an ALIGN_BYTES
+   boundary. Element (i,j) is at 'base' + i*'ld' + j, so
+   kernels can index flat memory; 'subs' points at each row
+   for the functions that take a 2D array. */
+
+typedef struct {
+   void  *base;    /* First element */
+   void **subs;    /* Address of each row */
+   int    rows;    /* Rows */
+   int    cols;    /* Cols */
+   int    ld;      /* Elements from one row to the next */
+} aligned_matrix;
+
+/* A process's block of matrix rows, read from the file a
+   few rows at a time. While the caller works on one block
+   the next is read into the other buffer, so a matrix far
+   larger than memory can be streamed at disk speed. */
+
+typedef struct {
+   int          m;          /* Matrix rows */
+   int          n;          /* Matrix cols */
+   int          lo;         /* First row of this process */
+   int          rows;       /* Rows of this process */
+   int          block_rows; /* Rows per block */
+   int          first;      /* First local row of the block
+                               last returned */
+   int          next;       /* Next local row to read */
+   int          pending;    /* Rows being read into
+                               'buf[cur]' */
+   int          cur;        /* Buffer being read into */
+   void        *buf[2];     /* The two blocks */
+   void       **subs[2];    /* Address of each row */
+   MPI_Datatype row_type;   /* One matrix row */
+   long long    offset;     /* First element in file */
+   size_t       row_bytes;  /* Bytes per row */
+   MPI_File     fh;         /* File, if opened by MPI-IO */
+   MPI_Request  request;    /* Read in progress */
+   FILE        *fp;         /* File, otherwise */
+   char        *name;       /* File name */
+   MPI_Comm     comm;       /* Communicator */
+   int          id;         /* Process rank */
+   unsigned int sum;        /* Share of checksum so far */
+   double       seconds;    /* Time spent on checksum */
+} row_stream;
+
+/* How the elements (or rows) 0..n-1 of an object are dealt
+   out among 'p' processes. DIST_BLOCK gives each process one
+   contiguous block, as the BLOCK_* macros do; DIST_CYCLIC
+   deals single elements round robin; DIST_BLOCK_CYCLIC deals
+   blocks of 'block' elements round robin; DIST_WEIGHTED gives
+   each process one contiguous block sized in proportion to
+   its weight. A process holds its elements in increasing
+   order of global index. */
+
+typedef struct {
+   int     kind;   /* DIST_* */
+   int     p;      /* Number of processes */
+   int     block;  /* Elements per block when dealt round
+                      robin */
+   double *share;  /* DIST_WEIGHTED: fraction of elements
+                      before each process, 'p'+1 entries */
+} distribution;
+
+/* Layout of a matrix over a grid of 'rows.p' x 'cols.p'
+   processes, numbered in row-major order as MPI_Cart_create
+   numbers them. Each process holds, in row-major order, the
+   rows given to its grid row and the cols given to its grid
+   col. A row-striped matrix has 'cols.p' == 1, a
+   column-striped matrix has 'rows.p' == 1. */
+
+typedef struct {
+   distribution rows;  /* Rows among grid rows */
+   distribution cols;  /* Cols among grid cols */
+} matrix_layout;
+
+/* Block of rows of a sparse matrix held in compressed sparse
+   row form. Row blocks are chosen so that processes hold
+   about the same number of nonzeros; 'row_cnt' and
+   'row_disp' give every process's block, ready for use as
+   the counts and displacements of an MPI_Allgatherv. */
+
+typedef struct {
+   int   m;          /* Matrix rows */
+   int   n;          /* Matrix cols */
+   int   rows;       /* Rows on this process */
+   int   row_lo;     /* First row on this process */
+   int   nnz;        /* Nonzeros on this process */
+   int  *row_ptr;    /* Start of each local row, 'rows'+1
+                        entries */
+   int  *col_idx;    /* Column of each nonzero */
+   void *values;     /* Value of each nonzero */
+   int  *row_cnt;    /* Rows on each process */
+   int  *row_disp;   /* First row of each process */
+} csr_matrix;
+
+/* Everything 'replicate_block_vector' works out on each call,
+   computed once for a given communicator, vector length,
+   element type and pair of buffers. With MPI-4 the plan
+   holds a persistent collective. A hierarchical plan keeps
+   one replicated vector per node, in shared memory, and
+   only the node leaders exchange data. */
+
+typedef struct {
+   void        *ablock;  /* Block-distributed vector */
+   void        *arep;    /* Replicated vector */
+   int          n;       /* Elements in vector */
+   MPI_Datatype dtype;   /* Element type */
+   MPI_Comm     comm;    /* Communicator */
+   int          id;      /* Process rank */
+   int         *cnt;     /* Elements from each process */
+   int         *disp;    /* Displacement of each block */
+   int          persistent; /* Is 'request' persistent? */
+   MPI_Request  request; /* Allgather of plan */
+   int          hierarchical; /* Is 'arep' shared by node? */
+   MPI_Comm     node_comm;   /* Processes on this node */
+   MPI_Comm     leader_comm; /* Node leaders, or
+                                MPI_COMM_NULL */
+   MPI_Win      win;         /* Window holding 'arep' */
+   int         *node_cnt;    /* Elements from each node */
+   int         *node_disp;   /* Each node's packed blocks */
+   int         *order;       /* Ranks in packed order, or
+                                NULL if that is rank order */
+   void        *packed;      /* Leader's exchange buffer */
+} replicate_plan;
+
+/* A replication started by 'ireplicate_block_vector', which
+   owns the count and displacement arrays until it ends */
+
+typedef struct {
+   MPI_Request  request; /* Non-blocking allgather */
+   int         *cnt;     /* Elements from each process */
+   int         *disp;    /* Displacement of each block */
+} replicate_request;
+
 /***************** MISCELLANEOUS FUNCTIONS *****************/
 
+void  alloc_aligned_matrix (int, int, int, MPI_Datatype, int,
+         aligned_matrix *);
+void  free_aligned_matrix (aligned_matrix *);
+void  free_csr_matrix (csr_matrix *);
+void  free_storage (void *);
+unsigned long long get_input_checksum (double *);
+int   get_size (MPI_Datatype);
+void *my_malloc (int, size_t);
+void  set_input_batch_rows (int);
+void  set_input_checksum (int);
+void  set_input_mode (int);
 void  terminate (int, char *);
 
 /*************** DATA DISTRIBUTION FUNCTIONS ***************/
 
+void create_distribution (int, int, int, double *,
+        distribution *);
+void free_distribution (distribution *);
+int  dist_owner (distribution *, int, int);
+int  dist_runs (distribution *, int, int, int **, int **);
+int  dist_size (distribution *, int, int);
+void create_dist_xfer_arrays (distribution *, int, int, int **,
+        int **);
+void redistribute_matrix (void *, matrix_layout *, void ***,
+        void **, matrix_layout *, MPI_Datatype, int, int,
+        MPI_Comm);
+
 void replicate_block_vector (void *, int, void *,
         MPI_Datatype, MPI_Comm);
+void create_replicate_plan (void *, int, void *,
+        MPI_Datatype, MPI_Comm, replicate_plan *);
+void create_shared_replicate_plan (void *, int, void **,
+        MPI_Datatype, MPI_Comm, replicate_plan *);
+void execute_replicate_plan (replicate_plan *);
+void free_replicate_plan (replicate_plan *);
+void start_replicate_plan (replicate_plan *);
+void wait_replicate_plan (replicate_plan *);
+void ireplicate_block_vector (void *, int, void *,
+        MPI_Datatype, MPI_Comm, replicate_request *);
+int  test_replicate (replicate_request *);
+void wait_replicate (replicate_request *);
 void create_mixed_xfer_arrays (int, int, int, int**, int**);
 void create_uniform_xfer_arrays (int, int, int, int**,int**);
 
@@ -44,8 +239,20 @@ void read_checkerboard_matrix (char *, void ***, void **,
         MPI_Datatype, int *, int *, MPI_Comm);
 void read_col_striped_matrix (char *, void ***, void **,
         MPI_Datatype, int *, int *, MPI_Comm);
+void read_dist_block_vector (char *, void **, MPI_Datatype,
+        int *, distribution *, MPI_Comm);
+void read_dist_row_striped_matrix (char *, void ***, void **,
+        MPI_Datatype, int *, int *, distribution *, MPI_Comm);
+void read_row_striped_aligned_matrix (char *, aligned_matrix *,
+        MPI_Datatype, int *, int *, int, MPI_Comm);
+void read_row_striped_csr (char *, csr_matrix *,
+        MPI_Datatype, MPI_Comm);
 void read_row_striped_matrix (char *, void ***, void **,
         MPI_Datatype, int *, int *, MPI_Comm);
+void open_row_stream (char *, MPI_Datatype, int, int *, int *,
+        MPI_Comm, row_stream *);
+int  next_row_block (row_stream *, void ***);
+void close_row_stream (row_stream *);
 void read_block_vector (char *, void **, MPI_Datatype,
         int *, MPI_Comm);
 void read_replicated_vector (char *, void **, MPI_Datatype,
@@ -57,9 +264,21 @@ void print_checkerboard_matrix (void **, MPI_Datatype, int,
         int, MPI_Comm);
 void print_col_striped_matrix (void **, MPI_Datatype, int,
         int, MPI_Comm);
+void print_dist_block_vector (void *, MPI_Datatype, int,
+        distribution *, MPI_Comm);
+void print_dist_row_striped_matrix (void **, MPI_Datatype, int,
+        int, distribution *, MPI_Comm);
 void print_row_striped_matrix (void **, MPI_Datatype, int,
         int, MPI_Comm);
 void print_block_vector (void *, MPI_Datatype, int,
         MPI_Comm);
 void print_replicated_vector (void *, MPI_Datatype, int,
         MPI_Comm);
+void write_checkerboard_matrix (char *, void **, MPI_Datatype,
+        int, int, MPI_Comm);
+void write_row_striped_matrix (char *, void **, MPI_Datatype,
+        int, int, MPI_Comm);
+void write_block_vector (char *, void *, MPI_Datatype, int,
+        MPI_Comm);
+void write_replicated_vector (char *, void *, MPI_Datatype,
+        int, MPI_Comm);
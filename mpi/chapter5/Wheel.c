@@ -0,0 +1,58 @@
+/*
+ *   Wheel.c -- Functions shared by the bit-packed wheel
+ *   sieves, sieve6 and sieve7
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Wheel.h"
+
+
+/*
+ *   Function 'small_sieve' finds the primes from 7 through
+ *   'limit' with a plain sieve of the odd integers, and
+ *   returns how many there are.
+ */
+
+int small_sieve (int limit, int **primes)
+{
+   int   count;
+   int   i, j;
+   char *odd;      /* odd[i] represents 2i+1 */
+   int   size;
+
+   size = limit / 2 + 1;
+   odd = (char *) malloc (size);
+   memset (odd, 1, size);
+   for (i = 1; (2*i+1) * (2*i+1) <= limit; i++)
+      if (odd[i])
+         for (j = (2*i+1) * (2*i+1) / 2; j < size; j += 2*i+1)
+            odd[j] = 0;
+   *primes = (int *) malloc (size * sizeof(int));
+   count = 0;
+   for (i = 3; i < size; i++)
+      if (odd[i] && (2*i+1 <= limit)) (*primes)[count++] = 2*i+1;
+   free (odd);
+   return count;
+}
+
+
+/*
+ *   Function 'count_bits' returns the number of bits set in
+ *   'len' bytes, eight bytes at a time.
+ */
+
+long long count_bits (unsigned char *a, long long len)
+{
+   long long          count;
+   long long          i;
+   unsigned long long word;
+
+   count = 0;
+   for (i = 0; i + 8 <= len; i += 8) {
+      memcpy (&word, a + i, 8);
+      count += __builtin_popcountll (word);
+   }
+   for (; i < len; i++) count += __builtin_popcount (a[i]);
+   return count;
+}
@@ -0,0 +1,9 @@
+/*   Wheel.h
+ *
+ *   Functions shared by the bit-packed wheel sieves, sieve6
+ *   and sieve7. Compile a program together with Wheel.c,
+ *   e.g. mpicc sieve6.c Wheel.c -lm
+ */
+
+int       small_sieve (int, int **);
+long long count_bits (unsigned char *, long long);
@@ -11,26 +11,27 @@
 #include "mpi.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #define MIN(a,b)  ((a)<(b)?(a):(b))
 
 int main (int argc, char *argv[])
 {
    double elapsed_time;
-   int   els;
-   int   global_count;
-   int   high_value;
-   int   i, m, count;
-   int   id;
-   int   index, prime, first, step;
-   int   larger_size;
-   int   local_count;
-   int   low_value;
-   char *marked;
-   int   num_larger_blocks;
-   int   p;
-   int   proc0_size;
-   int   smaller_size;
-   int   size;
+   long long els;
+   long long global_count;
+   long long high_value;
+   long long i, m, count;
+   int       id;
+   long long index, prime, first, step;
+   long long larger_size;
+   long long local_count;
+   long long low_value;
+   char     *marked;
+   long long num_larger_blocks;
+   int       p;
+   long long proc0_size;
+   long long smaller_size;
+   long long size;
 
    MPI_Init (&argc, &argv);
    MPI_Comm_rank (MPI_COMM_WORLD, &id);
@@ -43,7 +44,7 @@ int main (int argc, char *argv[])
       exit (1);
    }
 
-   m = atoi(argv[1]);
+   m = atoll(argv[1]);
    els = (m-1) / 2;       /* Only odd integers will be represented */
 
    /* Figure out this process's share of the array, as well as the
@@ -60,9 +61,9 @@ int main (int argc, char *argv[])
    if (num_larger_blocks > 0) proc0_size = larger_size;
    else proc0_size = smaller_size;
 
-   if ((1 + 2*proc0_size) < (int) sqrt((double)m)) {
+   if ((1 + 2*proc0_size) < (long long) sqrt((double)m)) {
       if (!id) printf ("Too many processes, given upper bound of sieve\n");
-      if (!id) printf ("proc0_size is %d and m is %d\n", proc0_size, m);
+      if (!id) printf ("proc0_size is %lld and m is %lld\n", proc0_size, m);
       MPI_Finalize();
       exit (1);
    }
@@ -83,7 +84,7 @@ int main (int argc, char *argv[])
    do {
       if (prime * prime > low_value) first = (prime * prime - low_value)/2;
       else {
-         int r = low_value % prime;
+         long long r = low_value % prime;
          if (!r) first = 0;
          else if ((prime - r) & 1)
             first = (2*prime - r)/2;
@@ -94,19 +95,20 @@ int main (int argc, char *argv[])
          while (marked[++index]);
          prime = 2*index + 3;
       }
-      MPI_Bcast (&prime,  1, MPI_INT, 0, MPI_COMM_WORLD);
+      MPI_Bcast (&prime,  1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
    } while (prime * prime <= m);
    count = 0;
    for (i = 0; i < size; i++)
       if (!marked[i]) count++;
-   MPI_Reduce (&count, &global_count, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+   MPI_Reduce (&count, &global_count, 1, MPI_LONG_LONG, MPI_SUM, 0,
+      MPI_COMM_WORLD);
 
    global_count++;   /* To account for the only even prime, 2 */
 
    elapsed_time += MPI_Wtime();
 
    if (!id) {
-      printf ("There are %d primes less than or equal to %d\n",
+      printf ("There are %lld primes less than or equal to %lld\n",
          global_count, m);
       printf ("SIEVE_ODD (%d) %10.6f\n", p, elapsed_time);
    }
@@ -17,42 +17,43 @@
 #include "mpi.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define MIN(a,b)  ((a)<(b)?(a):(b))
 
 main (int argc, char *argv[])
 {
-   int    current_prime;     /* Sieve by this prime */
+   long long current_prime;  /* Sieve by this prime */
    double elapsed_time;      /* Stopwatch */
    int    id_num;            /* Process rank */
-   int    n;                 /* Top integer to check */
+   long long n;              /* Top integer to check */
    int    p;                 /* Number of processors */
    int    sqrt_n;            /* Top value for sieve primes */
    char  *small_primes;      /* 1's show primes to sqrt(n) */
    char  *primes;            /* Share of values 3..n */
    int    small_prime_count; /* Number of sieve primes */
    int   *small_prime_values;/* Array of sieving primes */
-   int    index;             /* Sieving location */
-   int    i, j, k;
-   int    size;              /* Size of array 'primes' */
-   int    prime_count;       /* Primes on this proc */
-   int    low_proc_value;    /* Smallest int on this proc */
-   int    high_proc_value;   /* Highest int on this proc */
-   int    smaller_size;      /* Smaller block size */
-   int    larger_size;
-   int    num_larger_blocks;
+   long long index;          /* Sieving location */
+   long long i, j, k;
+   long long size;           /* Size of array 'primes' */
+   long long prime_count;    /* Primes on this proc */
+   long long low_proc_value; /* Smallest int on this proc */
+   long long high_proc_value;/* Highest int on this proc */
+   long long smaller_size;   /* Smaller block size */
+   long long larger_size;
+   long long num_larger_blocks;
    int blocks;
    int low;
    int high;
-   int global_count;
+   long long global_count;
    int small_prime_array_size;
-   int els;
+   long long els;
    
 
    MPI_Init (&argc, &argv);
    MPI_Barrier(MPI_COMM_WORLD);
    elapsed_time = -MPI_Wtime();
-   n = atoi (argv[1]);
+   n = atoll (argv[1]);
    MPI_Comm_rank (MPI_COMM_WORLD, &id_num);
    MPI_Comm_size (MPI_COMM_WORLD, &p);
    sqrt_n = (int) sqrt((double) n);
@@ -84,13 +85,13 @@ main (int argc, char *argv[])
       if (current_prime * current_prime > low_proc_value)
          index = (current_prime * current_prime - low_proc_value)/2;
       else {
-         int r = low_proc_value % current_prime;
+         long long r = low_proc_value % current_prime;
          if (!r) index = 0;
          else if ((current_prime - r) & 1)
             index = (2*current_prime - r)/2;
          else index = (current_prime - r)/2;
       }
-      if (index >= size) break;
+      if (current_prime * current_prime > high_proc_value) break;
       for (k = index; k < size; k+= current_prime)
          primes[k] = 0;
    }
@@ -98,12 +99,12 @@ main (int argc, char *argv[])
    prime_count = 0;
    for (j = 0; j < size; j++)
       if (primes[j]) prime_count++;
-   MPI_Reduce (&prime_count, &global_count, 1, MPI_INT, MPI_SUM, 0,
+   MPI_Reduce (&prime_count, &global_count, 1, MPI_LONG_LONG, MPI_SUM, 0,
       MPI_COMM_WORLD);
    if (!id_num) global_count++;   /* To account for only even prime, 2 */
    elapsed_time += MPI_Wtime();
    if (!id_num) {
-      printf ("Total prime count is %d\n", global_count);
+      printf ("Total prime count is %lld\n", global_count);
       printf ("SIEVE_ODD_NO_BCAST (%d) %10.6f\n", p, elapsed_time);
    }
    MPI_Finalize();
@@ -9,6 +9,22 @@
  *      Each process finds its own prime sieve values: no broadcast step
  *      Large array considered one cache block at a time to improve hit rate
  *
+ *   Command line: sieve4 <n> [dynamic] [presieve]
+ *
+ *   With 'dynamic', blocks are not assigned to processes in advance:
+ *   each process takes the next unsieved block from a counter on
+ *   process 0 (an MPI-3 atomic fetch-and-add), so that the process
+ *   holding the low, strike-heavy blocks no longer finishes last.
+ *
+ *   The primes 3 through 13 strike nearly every cache line of a block.
+ *   Instead of striking them one at a time, each block is first
+ *   copied from a pattern with their multiples already removed;
+ *   the pattern repeats every 3*5*7*11*13 odd integers. The strike
+ *   loop then starts at 17. With 'presieve' the program sieves
+ *   twice: first as usual, under the usual timing label, then with
+ *   the pattern, under a label ending in _PRESIEVE, and prints the
+ *   ratio of the two times.
+ *
  *   Programmer: Michael J. Quinn
  *
  *   Last modification: 6 September 2001
@@ -17,43 +33,60 @@
 #include "mpi.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define MIN(a,b)   ((a)<(b)?(a):(b))
 #define BLOCK_SIZE 15000
 
+/* Odd integers in one period of the pre-sieve pattern */
+
+#define PRESIEVE_PERIOD (3*5*7*11*13)
+
+static const int presieve_primes[] = { 3, 5, 7, 11, 13 };
+#define PRESIEVE_PRIMES 5
+
+long long sieve_block (char *, long long, long long, int *, int, char *);
+
 main (int argc, char *argv[])
 {
-   int blocks;                 /* Number of blocks in subarray */
-   int current_prime;          /* Prime currently used as sieve value */
+   long long blocks;           /* Number of blocks to sieve */
+   int dynamic;                /* Hand out blocks on demand? */
    double elapsed_time;        /* Elapsed wall clock time */
-   int els;                    /* Global total of elements in 'primes' */
-   int global_count;           /* Total number of primes up through n */
-   int high_block_index;       /* Last index of block being sieved */
-   int high_block_value;       /* Value of last element of block being sieved */
-   int high_proc_value;        /* Integer represented by last el in 'primes' */
-   int i;
+   long long els;              /* Global total of elements in 'primes' */
+   double finish_time;         /* When this process ran out of blocks */
+   double first_finish;        /* Earliest 'finish_time' */
+   long long global_count;     /* Total number of primes up through n */
+   long long high_proc_value;  /* Integer represented by last el in 'primes' */
+   long long i;
    int id;                     /* Process ID number */
-   int index;                  /* Location of first multiple of 'current_prime'
-                                  in array 'primes' */
-   int j;
-   int k;
-   int larger_size;            /* Larger subarray size */
-   int low_block_index;        /* First index of block being sieved */
-   int low_block_value;        /* Value of 1st element of block being sieved */
-   int low_proc_value;         /* Integer represented by 1st el in 'primes' */
-   int n;                      /* Upper limit of sieve */
-   int num_larger_blocks;      /* Number of processes with larger subarrays */
+   long long j;
+   long long larger_size;      /* Larger subarray size */
+   double last_finish;         /* Latest 'finish_time' */
+   int pass;                   /* 1 when sieving from 'pattern' */
+   double plain_time;          /* Time taken without the pattern */
+   int presieve;               /* Also sieve from 'pattern'? */
+   char *pattern;              /* Odd integers 3,5,... with multiples
+                                  of 3 through 13 struck */
+   long long low_proc_value;   /* Integer represented by 1st el in 'primes' */
+   long long n;                /* Upper limit of sieve */
+   long long *next_block;      /* Counter of blocks handed out (process 0) */
+   long long num_larger_blocks;/* Number of processes with larger subarrays */
+   long long one = 1;
    int p;                      /* Number of processes */
-   int prime_count;            /* Number of primes in 'prime' */
-   char *primes;               /* Process's portion of integers 3,5,...,n */
-   int size;                   /* Number of elements in 'primes' */
+   long long prime_count;      /* Number of primes in 'prime' */
+   char *primes;               /* Block of integers 3,5,...,n being sieved */
+   double setup_time;          /* Time to find the sieving primes */
+   long long size;             /* Number of elements in 'primes' */
    int small_prime_array_size; /* Number of elements in 'small_primes' */
    int small_prime_count;      /* Number of odd primes through sqrt(n) */
    int *small_prime_values;    /* List of odd primes up to sqrt(n) */
    char *small_primes;         /* Used to sieve odd primes up to sqrt(n) */
-   int smaller_size;           /* Smaller subarray size */
+   long long smaller_size;     /* Smaller subarray size */
    int sqrt_n;                 /* Square root of n, rounded down */
-   
+#if MPI_VERSION >= 3
+   MPI_Win win;                /* Exposes 'next_block' */
+#endif
 
    MPI_Init (&argc, &argv);
    MPI_Barrier(MPI_COMM_WORLD);
@@ -61,7 +94,13 @@ main (int argc, char *argv[])
    /* Start timer */
 
    elapsed_time = -MPI_Wtime();
-   n = atoi (argv[1]);
+   n = atoll (argv[1]);
+   dynamic = 0;
+   presieve = 0;
+   for (i = 2; i < argc; i++) {
+      if (!strcmp (argv[i], "dynamic")) dynamic = 1;
+      else if (!strcmp (argv[i], "presieve")) presieve = 1;
+   }
    MPI_Comm_rank (MPI_COMM_WORLD, &id);
    MPI_Comm_size (MPI_COMM_WORLD, &p);
    sqrt_n = (int) sqrt((double) n);
@@ -82,50 +121,154 @@ main (int argc, char *argv[])
    else size = smaller_size;
    low_proc_value = 2*(id*smaller_size + MIN(id, num_larger_blocks)) + 3;
    high_proc_value = low_proc_value + 2 * (size-1);
-   primes = (char *) malloc (size);
+   primes = (char *) malloc (BLOCK_SIZE);
 
-   blocks = size / BLOCK_SIZE;
-   if (BLOCK_SIZE * blocks < size) blocks++;
-   prime_count = 0;
-   for (i = 0; i < blocks; i++) {
-      low_block_index = i * BLOCK_SIZE;
-      high_block_index = ((i + 1) * BLOCK_SIZE) - 1;
-      if (high_block_index > size-1) high_block_index = size-1;
-      for (j = low_block_index; j <= high_block_index; j++) primes[j] = 1;
-      low_block_value = low_proc_value + 2*low_block_index;
-      high_block_value = low_proc_value + 2*high_block_index;
-      for (j = 0; j < small_prime_count; j++) {
-         current_prime = small_prime_values[j];
-         if (current_prime * current_prime > low_block_value)
-            index = low_block_index +
-               (current_prime * current_prime - low_block_value)/2;
-         else {
-            int r = low_block_value % current_prime;
-            if (!r) index = low_block_index;
-            else if ((current_prime - r) & 1)
-               index = low_block_index + (2*current_prime - r)/2;
-            else index = low_block_index + (current_prime - r)/2;
+   setup_time = elapsed_time + MPI_Wtime();
+   pattern = NULL;
+   for (pass = 0; pass <= presieve; pass++) {
+
+      /* The second pass is timed from here, plus the time both
+         passes spent finding the sieving primes. Its pattern is
+         one period plus a block, so that any block is a single
+         copy from it. */
+
+      if (pass) {
+         MPI_Barrier (MPI_COMM_WORLD);
+         elapsed_time = setup_time - MPI_Wtime();
+         pattern = (char *) malloc (PRESIEVE_PERIOD + BLOCK_SIZE);
+         for (i = 0; i < PRESIEVE_PERIOD + BLOCK_SIZE; i++) {
+            pattern[i] = 1;
+            for (j = 0; j < PRESIEVE_PRIMES; j++)
+               if ((2*i+3) % presieve_primes[j] == 0) pattern[i] = 0;
          }
-         if (index > high_block_index) break;
-         for (k = index; k <= high_block_index; k+= current_prime)
-            primes[k] = 0;
       }
-      for (j = low_block_index; j <= high_block_index; j++)
-         if (primes[j]) prime_count++;
-   }
-   MPI_Reduce (&prime_count, &global_count, 1, MPI_INT, MPI_SUM, 0,
-      MPI_COMM_WORLD);
-   if (!id) global_count++;   /* To account for only even prime, 2 */
-   elapsed_time += MPI_Wtime();
-   if (!id) {
-      printf ("Total prime count is %d\n", global_count);
-      printf ("SIEVE_ODD_NO_BCAST_CACHE (%d) %10.6f\n",
-         p, elapsed_time);
+
+      prime_count = 0;
+      if (dynamic) {
+
+         /* Blocks of the whole array 3,5,...,n are handed out one
+            at a time by a counter on process 0, so a process that
+            draws cheap blocks simply draws more of them */
+
+#if MPI_VERSION >= 3
+         blocks = (els + BLOCK_SIZE - 1) / BLOCK_SIZE;
+         MPI_Win_allocate ((id ? 0 : sizeof(long long)), sizeof(long long),
+            MPI_INFO_NULL, MPI_COMM_WORLD, &next_block, &win);
+         if (!id) *next_block = 0;
+         MPI_Barrier (MPI_COMM_WORLD);
+         MPI_Win_lock_all (0, win);
+         for (;;) {
+            MPI_Fetch_and_op (&one, &i, MPI_LONG_LONG, 0, 0, MPI_SUM, win);
+            MPI_Win_flush (0, win);
+            if (i >= blocks) break;
+            prime_count += sieve_block (primes, 3 + 2*i*BLOCK_SIZE,
+               MIN(BLOCK_SIZE, els - i*BLOCK_SIZE), small_prime_values,
+               small_prime_count, pattern);
+         }
+         MPI_Win_unlock_all (win);
+         finish_time = elapsed_time + MPI_Wtime();
+         MPI_Win_free (&win);
+#else
+         if (!id) printf ("Dynamic mode needs MPI-3\n");
+         MPI_Finalize();
+         exit (1);
+#endif
+      } else {
+         blocks = size / BLOCK_SIZE;
+         if (BLOCK_SIZE * blocks < size) blocks++;
+         for (i = 0; i < blocks; i++)
+            prime_count += sieve_block (primes,
+               low_proc_value + 2*i*BLOCK_SIZE,
+               MIN(BLOCK_SIZE, size - i*BLOCK_SIZE), small_prime_values,
+               small_prime_count, pattern);
+         finish_time = elapsed_time + MPI_Wtime();
+      }
+
+      /* Spread between the first and last process to finish */
+
+      MPI_Reduce (&finish_time, &first_finish, 1, MPI_DOUBLE, MPI_MIN, 0,
+         MPI_COMM_WORLD);
+      MPI_Reduce (&finish_time, &last_finish, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+      MPI_Reduce (&prime_count, &global_count, 1, MPI_LONG_LONG, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+      if (!id) global_count++;   /* To account for only even prime, 2 */
+      elapsed_time += MPI_Wtime();
+      if (!id) {
+         printf ("Total prime count is %lld\n", global_count);
+         printf ("SIEVE_ODD_NO_BCAST_CACHE%s%s (%d) %10.6f\n",
+            dynamic ? "_DYNAMIC" : "", pass ? "_PRESIEVE" : "",
+            p, elapsed_time);
+         if (dynamic)
+            printf ("Finish spread %10.6f\n", last_finish - first_finish);
+         if (pass)
+            printf ("Presieve speedup %6.2f\n", plain_time / elapsed_time);
+      }
+      plain_time = elapsed_time;
    }
    MPI_Finalize();
    return 0;
 }
 
+/*
+ *   Function 'sieve_block' sieves the 'len' odd integers starting
+ *   at 'low_block_value' in array 'primes' and returns how many
+ *   of them are prime. If 'pattern' is not NULL the block starts
+ *   as a copy of it, and only primes past 13 are struck.
+ */
+
+long long sieve_block (char *primes, long long low_block_value,
+   long long len, int *small_prime_values, int small_prime_count,
+   char *pattern)
+{
+   long long current_prime;    /* Prime currently used as sieve value */
+   long long high_block_value; /* Value of last element of block */
+   long long index;            /* Location of first multiple of
+                                  'current_prime' in array 'primes' */
+   long long j;
+   long long k;
+   long long prime_count;      /* Number of primes in block */
+   long long q;
+
+   high_block_value = low_block_value + 2*(len-1);
+   j = 0;
+   if (pattern != NULL) {
+      memcpy (primes, pattern + (low_block_value - 3)/2 % PRESIEVE_PERIOD,
+         len);
+
+      /* The pattern strikes the pre-sieve primes themselves */
+
+      for (k = 0; k < PRESIEVE_PRIMES; k++) {
+         q = presieve_primes[k];
+         if ((q >= low_block_value) && (q <= high_block_value))
+            primes[(q - low_block_value)/2] = 1;
+      }
+      while ((j < small_prime_count) &&
+             (small_prime_values[j] <= presieve_primes[PRESIEVE_PRIMES-1]))
+         j++;
+   } else
+      for (k = 0; k < len; k++) primes[k] = 1;
+   for (; j < small_prime_count; j++) {
+      current_prime = small_prime_values[j];
+      if (current_prime * current_prime > high_block_value) break;
+      if (current_prime * current_prime > low_block_value)
+         index = (current_prime * current_prime - low_block_value)/2;
+      else {
+         long long r = low_block_value % current_prime;
+         if (!r) index = 0;
+         else if ((current_prime - r) & 1)
+            index = (2*current_prime - r)/2;
+         else index = (current_prime - r)/2;
+      }
+      for (k = index; k < len; k += current_prime)
+         primes[k] = 0;
+   }
+   prime_count = 0;
+   for (j = 0; j < len; j++)
+      if (primes[j]) prime_count++;
+   return prime_count;
+}
+
 seq_sieve (char *small_primes, int small_prime_array_size, int sqrt_n)
 {
    int i, j;
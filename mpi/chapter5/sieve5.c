@@ -10,25 +10,26 @@
 #include "mpi.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #define MIN(a,b)  ((a)<(b)?(a):(b))
 
 int main (int argc, char *argv[])
 {
-   int    count;        /* Local prime count */
-   double elapsed_time; /* Parallel execution time */
-   int    first;        /* Index of first multiple */
-   int    global_count; /* Global prime count */
-   int    high_value;   /* Highest value on this proc */
-   int    i;
-   int    id;           /* Process ID number */
-   int    index;        /* Index of current prime */
-   int    low_value;    /* Lowest value on this proc */
-   char  *marked;       /* Portion of 2,...,'n' */
-   int    n;            /* Sieving from 2, ..., 'n' */
-   int    p;            /* Number of processes */
-   int    proc0_size;   /* Size of proc 0's subarray */
-   int    prime;        /* Current prime */
-   int    size;         /* Elements in 'marked' */
+   long long count;        /* Local prime count */
+   double    elapsed_time; /* Parallel execution time */
+   long long first;        /* Index of first multiple */
+   long long global_count; /* Global prime count */
+   long long high_value;   /* Highest value on this proc */
+   long long i;
+   int       id;           /* Process ID number */
+   long long index;        /* Index of current prime */
+   long long low_value;    /* Lowest value on this proc */
+   char     *marked;       /* Portion of 2,...,'n' */
+   long long n;            /* Sieving from 2, ..., 'n' */
+   int       p;            /* Number of processes */
+   long long proc0_size;   /* Size of proc 0's subarray */
+   long long prime;        /* Current prime */
+   long long size;         /* Elements in 'marked' */
    MPI_Status status;   /* Result of receive */
 
    MPI_Init (&argc, &argv);
@@ -46,7 +47,7 @@ int main (int argc, char *argv[])
       exit (1);
    }
 
-   n = atoi(argv[1]);
+   n = atoll(argv[1]);
 
    /* Figure out this process's share of the array, as
       well as the integers represented by the first and
@@ -61,7 +62,7 @@ int main (int argc, char *argv[])
 
    proc0_size = (n-1)/p;
 
-   if ((2 + proc0_size) < (int) sqrt((double) n)) {
+   if ((2 + proc0_size) < (long long) sqrt((double) n)) {
       if (!id) printf ("Too many processes\n");
       MPI_Finalize();
       exit (1);
@@ -94,17 +95,18 @@ int main (int argc, char *argv[])
       }
       if (p > 1) {
          if (id > 0) {
-            MPI_Recv (&prime, 1, MPI_INT, id-1, 0, MPI_COMM_WORLD, &status);
+            MPI_Recv (&prime, 1, MPI_LONG_LONG, id-1, 0, MPI_COMM_WORLD,
+               &status);
          }
          if (id < (p-1)) {
-            MPI_Send (&prime, 1, MPI_INT, id+1, 0, MPI_COMM_WORLD);
+            MPI_Send (&prime, 1, MPI_LONG_LONG, id+1, 0, MPI_COMM_WORLD);
          }
       }
    } while (prime * prime <= n);
    count = 0;
    for (i = 0; i < size; i++)
       if (!marked[i]) count++;
-   MPI_Reduce (&count, &global_count, 1, MPI_INT, MPI_SUM,
+   MPI_Reduce (&count, &global_count, 1, MPI_LONG_LONG, MPI_SUM,
       0, MPI_COMM_WORLD);
 
    /* Stop the timer */
@@ -115,7 +117,7 @@ int main (int argc, char *argv[])
    /* Print the results */
 
    if (!id) {
-      printf ("There are %d primes less than or equal to %d\n",
+      printf ("There are %lld primes less than or equal to %lld\n",
          global_count, n);
       printf ("SIEVE-SEND-RECV (%d) %10.6f\n", p, elapsed_time);
    }
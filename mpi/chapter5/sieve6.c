@@ -0,0 +1,172 @@
+/*
+ *   Sieve of Eratosthenes
+ *      Bit-packed wheel, sieved one segment at a time
+ *
+ *   Enhancements over sieve4:
+ *      Only integers prime to 2, 3 and 5 are represented,
+ *         one bit each: a byte covers 30 integers
+ *      Each segment fits in the level-1 (or, for large n,
+ *         level-2) cache
+ *      Primes are counted eight bytes at a time with popcount
+ *      64-bit bounds, so 'n' may exceed 2^31
+ *
+ *   Compile together with Wheel.c (e.g. mpicc sieve6.c
+ *   Wheel.c -lm)
+ */
+
+#include "mpi.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Wheel.h"
+
+#define MIN(a,b)  ((a)<(b)?(a):(b))
+#define MAX(a,b)  ((a)>(b)?(a):(b))
+
+/* Bytes sieved at a time. 32 KB covers 983,040 integers.
+   For large 'n' a segment is stretched to sqrt(n) bytes, so
+   that every sieving prime strikes every segment and the
+   cost of visiting a prime is spread over its strikes. */
+
+#define SEGMENT_BYTES 32768
+
+/* Bit i of byte k represents integer 30k + wheel[i] */
+
+static const int wheel[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+/* Bit of residue r (mod 30), or -1 if r is not prime to 30 */
+
+static int bit_of[30];
+
+
+
+int main (int argc, char *argv[])
+{
+   unsigned char *bit;      /* Bit struck by each (prime,class) */
+   long long  count;        /* Local prime count */
+   double     elapsed_time; /* Parallel execution time */
+   long long  first_byte;   /* First byte on this proc */
+   long long  global_count; /* Global prime count */
+   long long  high_byte;    /* One past last byte on this proc */
+   int        i, j;
+   int        id;           /* Process ID number */
+   long long  k;
+   long long  m;            /* Multiplier of a prime */
+   long long  n;            /* Sieving from 2, ..., 'n' */
+   long long *next;         /* Next byte struck by each
+                               (prime,class) */
+   long long  nbytes;       /* Bytes covering 1, ..., 'n' */
+   int        nprimes;      /* Number of sieving primes */
+   int        p;            /* Number of processes */
+   int        prime;        /* Current prime */
+   int       *primes;       /* Sieving primes, 7 to sqrt(n) */
+   long long  seg_bytes;    /* Bytes per segment */
+   long long  seg_hi;       /* One past last byte of segment */
+   long long  seg_lo;       /* First byte of segment */
+   unsigned char *segment;  /* Bytes seg_lo, ..., seg_hi-1 */
+   int        sqrt_n;       /* Square root of n, rounded down */
+   long long  value;        /* A multiple of 'prime' */
+
+   MPI_Init (&argc, &argv);
+
+   /* Start the timer */
+
+   MPI_Comm_rank (MPI_COMM_WORLD, &id);
+   MPI_Comm_size (MPI_COMM_WORLD, &p);
+   MPI_Barrier(MPI_COMM_WORLD);
+   elapsed_time = -MPI_Wtime();
+
+   if (argc != 2) {
+      if (!id) printf ("Command line: %s <m>\n", argv[0]);
+      MPI_Finalize();
+      exit (1);
+   }
+
+   n = atoll(argv[1]);
+
+   for (i = 0; i < 30; i++) bit_of[i] = -1;
+   for (i = 0; i < 8; i++) bit_of[wheel[i]] = i;
+
+   /* Every process finds the sieving primes itself */
+
+   sqrt_n = (int) sqrt ((double) n);
+   while ((long long) sqrt_n * sqrt_n > n) sqrt_n--;
+   while ((long long) (sqrt_n + 1) * (sqrt_n + 1) <= n) sqrt_n++;
+   nprimes = small_sieve (sqrt_n, &primes);
+
+   /* Figure out this process's share of the bytes */
+
+   nbytes = n / 30 + 1;
+   first_byte = id * nbytes / p;
+   high_byte = (id + 1) * nbytes / p;
+
+   /* For each sieving prime and each of the eight classes
+      of multipliers prime to 30, find the first multiple on
+      this process. Later multiples of the class are 'prime'
+      bytes apart and all strike the same bit. */
+
+   next = (long long *) malloc (8 * MAX(nprimes,1) * sizeof(long long));
+   bit = (unsigned char *) malloc (8 * MAX(nprimes,1));
+   seg_bytes = MAX(SEGMENT_BYTES, sqrt_n);
+   segment = (unsigned char *) malloc (seg_bytes);
+   if ((next == NULL) || (bit == NULL) || (segment == NULL)) {
+      printf ("Cannot allocate enough memory\n");
+      MPI_Finalize();
+      exit (1);
+   }
+   for (j = 0; j < nprimes; j++) {
+      prime = primes[j];
+      m = MAX(prime, (30 * first_byte + prime - 1) / prime);
+      for (i = 0; i < 8; i++) {
+         value = (long long) prime *
+            (m + (wheel[i] - m % 30 + 30) % 30);
+         next[8*j+i] = value / 30;
+         bit[8*j+i] = 1 << bit_of[value % 30];
+      }
+   }
+
+   count = 0;
+   for (seg_lo = first_byte; seg_lo < high_byte;
+        seg_lo += seg_bytes) {
+      seg_hi = MIN(seg_lo + seg_bytes, high_byte);
+      memset (segment, 0xff, seg_hi - seg_lo);
+      if (!seg_lo) segment[0] &= ~1;      /* 1 is not prime */
+      for (j = 0; j < 8 * nprimes; j++) {
+         prime = primes[j/8];
+         for (k = next[j] - seg_lo; k < seg_hi - seg_lo; k += prime)
+            segment[k] &= ~bit[j];
+         next[j] = seg_lo + k;
+      }
+
+      /* Integers past 'n' in the last byte are not counted */
+
+      if (seg_hi == nbytes)
+         for (i = 0; i < 8; i++)
+            if (30 * (nbytes - 1) + wheel[i] > n)
+               segment[seg_hi - seg_lo - 1] &= ~(1 << i);
+      count += count_bits (segment, seg_hi - seg_lo);
+   }
+
+   MPI_Reduce (&count, &global_count, 1, MPI_LONG_LONG, MPI_SUM,
+      0, MPI_COMM_WORLD);
+
+   /* The wheel leaves out 2, 3 and 5 */
+
+   if (!id) global_count += (n >= 2) + (n >= 3) + (n >= 5);
+
+   /* Stop the timer */
+
+   elapsed_time += MPI_Wtime();
+
+
+   /* Print the results */
+
+   if (!id) {
+      printf ("There are %lld primes less than or equal to %lld\n",
+         global_count, n);
+      printf ("SIEVE_WHEEL_BITS (%d) %10.6f\n", p, elapsed_time);
+   }
+   MPI_Finalize ();
+   return 0;
+}
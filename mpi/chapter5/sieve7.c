@@ -0,0 +1,245 @@
+/*
+ *   Sieve of Eratosthenes
+ *      Hybrid MPI/OpenMP version of the bit-packed wheel sieve
+ *
+ *   Each process finds the sieving primes once, and its
+ *   threads share them. The process's range is cut into
+ *   cache-sized segments, which are dealt out to the threads
+ *   in turn: thread t sieves segments t, t+T, t+2T, ... Each
+ *   thread keeps its own count and its own place in the
+ *   strikes of every prime. One process per node is enough,
+ *   so far fewer copies of the sieving primes are made than
+ *   with one process per core.
+ *
+ *   Command line: sieve7 <n> [<threads>]
+ *
+ *   Compile with OpenMP enabled and together with Wheel.c
+ *   (e.g. mpicc -fopenmp sieve7.c Wheel.c -lm); without
+ *   OpenMP the program runs one thread per process, as it
+ *   does if the MPI library cannot support threads.
+ */
+
+#include "mpi.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Wheel.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define MIN(a,b)  ((a)<(b)?(a):(b))
+#define MAX(a,b)  ((a)>(b)?(a):(b))
+
+/* Bytes sieved at a time, as in sieve6. Every thread has a
+   segment of its own, so the segments of the threads
+   sharing a core's level-2 cache must fit there together. */
+
+#define SEGMENT_BYTES 32768
+
+/* Bit i of byte k represents integer 30k + wheel[i] */
+
+static const int wheel[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+/* Bit of residue r (mod 30), or -1 if r is not prime to 30 */
+
+static int bit_of[30];
+
+
+
+int main (int argc, char *argv[])
+{
+   unsigned char *bit;      /* Bit struck by each (prime,class) */
+   long long  count;        /* Local prime count */
+   double     elapsed_time; /* Parallel execution time */
+   int        failed;       /* Set if a thread cannot
+                               allocate its buffers */
+   long long  first_byte;   /* First byte on this proc */
+   long long  global_count; /* Global prime count */
+   long long  high_byte;    /* One past last byte on this proc */
+   int        i, j;
+   int        id;           /* Process ID number */
+   long long  n;            /* Sieving from 2, ..., 'n' */
+   long long  nbytes;       /* Bytes covering 1, ..., 'n' */
+   int        nprimes;      /* Number of sieving primes */
+   long long  nsegs;        /* Segments on this proc */
+   int        p;            /* Number of processes */
+   int        prime;        /* Current prime */
+   int       *primes;       /* Sieving primes, 7 to sqrt(n) */
+   int        provided;     /* Thread support of MPI library */
+   long long  seg_bytes;    /* Bytes per segment */
+   int        sqrt_n;       /* Square root of n, rounded down */
+   int        threads;      /* Threads per process */
+
+   /* Only the master thread makes MPI calls */
+
+   MPI_Init_thread (&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+   /* Start the timer */
+
+   MPI_Comm_rank (MPI_COMM_WORLD, &id);
+   MPI_Comm_size (MPI_COMM_WORLD, &p);
+   MPI_Barrier(MPI_COMM_WORLD);
+   elapsed_time = -MPI_Wtime();
+
+   if ((argc != 2) && (argc != 3)) {
+      if (!id) printf ("Command line: %s <m> [<threads>]\n", argv[0]);
+      MPI_Finalize();
+      exit (1);
+   }
+
+   n = atoll(argv[1]);
+#ifdef _OPENMP
+   if (argc == 3) omp_set_num_threads (atoi(argv[2]));
+
+   /* Without at least MPI_THREAD_FUNNELED even threads that
+      make no MPI calls are not allowed */
+
+   if (provided < MPI_THREAD_FUNNELED) {
+      if (!id) printf ("MPI library lacks MPI_THREAD_FUNNELED; "
+         "using one thread per process\n");
+      omp_set_num_threads (1);
+   }
+   threads = omp_get_max_threads();
+#else
+   threads = 1;
+#endif
+
+   for (i = 0; i < 30; i++) bit_of[i] = -1;
+   for (i = 0; i < 8; i++) bit_of[wheel[i]] = i;
+
+   sqrt_n = (int) sqrt ((double) n);
+   while ((long long) sqrt_n * sqrt_n > n) sqrt_n--;
+   while ((long long) (sqrt_n + 1) * (sqrt_n + 1) <= n) sqrt_n++;
+   nprimes = small_sieve (sqrt_n, &primes);
+
+   /* Figure out this process's share of the bytes */
+
+   nbytes = n / 30 + 1;
+   first_byte = id * nbytes / p;
+   high_byte = (id + 1) * nbytes / p;
+   seg_bytes = MAX(SEGMENT_BYTES, sqrt_n);
+   nsegs = (high_byte - first_byte + seg_bytes - 1) / seg_bytes;
+
+   /* The bit a (prime,class) pair strikes is the same in
+      every segment, so all threads share these */
+
+   bit = (unsigned char *) malloc (8 * MAX(nprimes,1));
+   if (bit == NULL) {
+      printf ("Cannot allocate enough memory\n");
+      MPI_Finalize();
+      exit (1);
+   }
+   for (j = 0; j < nprimes; j++)
+      for (i = 0; i < 8; i++)
+         bit[8*j+i] = 1 << bit_of[primes[j] % 30 * wheel[i] % 30];
+
+   count = 0;
+   failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:count) private(i, j, prime)
+#endif
+   {
+      long long  k;
+      long long  m;         /* Multiplier of a prime */
+      long long *next;      /* Next byte struck by each
+                               (prime,class) */
+      long long  s;         /* Segment number */
+      long long  seg_hi;    /* One past last byte of segment */
+      long long  seg_lo;    /* First byte of segment */
+      unsigned char *segment;  /* Bytes seg_lo, ..., seg_hi-1 */
+      int        t;         /* Thread number */
+      long long  value;     /* A multiple of 'prime' */
+
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+#else
+      t = 0;
+#endif
+      next = (long long *) malloc (8 * MAX(nprimes,1) *
+         sizeof(long long));
+      segment = (unsigned char *) malloc (seg_bytes);
+
+      /* Only the master thread may call MPI, so a failure is
+         reported after the parallel region */
+
+      if ((next == NULL) || (segment == NULL)) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+         failed = 1;
+      } else {
+         /* First strike of each (prime,class) pair at or
+            after the thread's first segment */
+
+         seg_lo = first_byte + t * seg_bytes;
+         for (j = 0; j < nprimes; j++) {
+            prime = primes[j];
+            m = MAX(prime, (30 * seg_lo + prime - 1) / prime);
+            for (i = 0; i < 8; i++) {
+               value = (long long) prime *
+                  (m + (wheel[i] - m % 30 + 30) % 30);
+               next[8*j+i] = value / 30;
+            }
+         }
+
+         for (s = t; s < nsegs; s += threads) {
+            seg_lo = first_byte + s * seg_bytes;
+            seg_hi = MIN(seg_lo + seg_bytes, high_byte);
+            memset (segment, 0xff, seg_hi - seg_lo);
+            if (!seg_lo) segment[0] &= ~1;   /* 1 is not prime */
+            for (j = 0; j < 8 * nprimes; j++) {
+               prime = primes[j/8];
+
+               /* Skip the strikes that fell in the segments
+                  of the other threads */
+
+               k = next[j] - seg_lo;
+               if (k < 0) k = (k % prime + prime) % prime;
+               for (; k < seg_hi - seg_lo; k += prime)
+                  segment[k] &= ~bit[j];
+               next[j] = seg_lo + k;
+            }
+
+            /* Integers past 'n' in the last byte are not
+               counted */
+
+            if (seg_hi == nbytes)
+               for (i = 0; i < 8; i++)
+                  if (30 * (nbytes - 1) + wheel[i] > n)
+                     segment[seg_hi - seg_lo - 1] &= ~(1 << i);
+            count += count_bits (segment, seg_hi - seg_lo);
+         }
+      }
+      free (segment);
+      free (next);
+   }
+   if (failed) {
+      printf ("Cannot allocate enough memory\n");
+      MPI_Abort (MPI_COMM_WORLD, 1);
+   }
+
+   MPI_Reduce (&count, &global_count, 1, MPI_LONG_LONG, MPI_SUM,
+      0, MPI_COMM_WORLD);
+
+   /* The wheel leaves out 2, 3 and 5 */
+
+   if (!id) global_count += (n >= 2) + (n >= 3) + (n >= 5);
+
+   /* Stop the timer */
+
+   elapsed_time += MPI_Wtime();
+
+
+   /* Print the results */
+
+   if (!id) {
+      printf ("There are %lld primes less than or equal to %lld\n",
+         global_count, n);
+      printf ("SIEVE_WHEEL_HYBRID (%d x %d) %10.6f\n", p, threads,
+         elapsed_time);
+   }
+   MPI_Finalize ();
+   return 0;
+}
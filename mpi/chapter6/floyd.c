@@ -3,7 +3,9 @@
  *
  *   Given an NxN matrix of distances between pairs of
  *   vertices, this MPI program computes the shortest path
- *   between every pair of vertices.
+ *   between every pair of vertices. If a second file name is
+ *   given, the matrix of shortest paths is written to it.
+ *   Compile with -DLONG_DISTANCES for 64-bit distances.
  *
  *   This program shows:
  *      how to dynamically allocate multidimensional arrays
@@ -20,12 +22,16 @@
 #include <mpi.h>
 #include "../MyMPI.h"
 
+#ifdef LONG_DISTANCES
+typedef long long dtype;
+#define MPI_TYPE MPI_LONG_LONG
+#else
 typedef int dtype;
 #define MPI_TYPE MPI_INT
+#endif
 
 int main (int argc, char *argv[]) {
-   dtype** a;         /* Doubly-subscripted array */
-   dtype*  storage;   /* Local portion of array elements */
+   aligned_matrix a;  /* Local rows, each 64-byte aligned */
    int     i, j, k;
    int     id;        /* Process rank */
    int     m;         /* Rows in matrix */
@@ -33,42 +39,54 @@ int main (int argc, char *argv[]) {
    int     p;         /* Number of processes */
    double  time, max_time;
 
-   void compute_shortest_paths (int, int, int**, int);
+   void compute_shortest_paths (int, int, dtype *, int, int);
 
    MPI_Init (&argc, &argv);
    MPI_Comm_rank (MPI_COMM_WORLD, &id);
    MPI_Comm_size (MPI_COMM_WORLD, &p);
 
-   read_row_striped_matrix (argv[1], (void *) &a,
-      (void *) &storage, MPI_TYPE, &m, &n, MPI_COMM_WORLD);
+   read_row_striped_aligned_matrix (argv[1], &a, MPI_TYPE, &m,
+      &n, 0, MPI_COMM_WORLD);
 
    if (m != n) terminate (id, "Matrix must be square\n");
 
 /*
-   print_row_striped_matrix ((void **) a, MPI_TYPE, m, n,
+   print_row_striped_matrix (a.subs, MPI_TYPE, m, n,
       MPI_COMM_WORLD);
 */
    MPI_Barrier (MPI_COMM_WORLD);
    time = -MPI_Wtime();
-   compute_shortest_paths (id, p, (dtype **) a, n);
+   compute_shortest_paths (id, p, (dtype *) a.base, a.ld, n);
    time += MPI_Wtime();
    MPI_Reduce (&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0,
       MPI_COMM_WORLD);
    if (!id) printf ("Floyd, matrix size %d, %d processes: %6.2f seconds\n",
       n, p, max_time);
 /*
-   print_row_striped_matrix ((void **) a, MPI_TYPE, m, n,
+   print_row_striped_matrix (a.subs, MPI_TYPE, m, n,
       MPI_COMM_WORLD);
 */
+
+   /* Optionally save the distance matrix for later runs */
+
+   if (argc > 2)
+      write_row_striped_matrix (argv[2], a.subs, MPI_TYPE,
+         m, n, MPI_COMM_WORLD);
+   free_aligned_matrix (&a);
    MPI_Finalize();
 }
 
-void compute_shortest_paths (int id, int p, dtype **a, int n)
+/* Element (i,j) of the local rows is a[i*ld+j] */
+
+void compute_shortest_paths (int id, int p, dtype *a, int ld,
+   int n)
 {
-   int  i, j, k;
-   int  offset;   /* Local index of broadcast row */
-   int  root;     /* Process controlling row to be bcast */
-   int* tmp;      /* Holds the broadcast row */
+   int    i, j, k;
+   dtype  aik;     /* Distance from row i to vertex k */
+   int    offset;  /* Local index of broadcast row */
+   int    root;    /* Process controlling row to be bcast */
+   dtype *row;     /* Current local row */
+   dtype *tmp;     /* Holds the broadcast row */
 
    tmp = (dtype *) malloc (n * sizeof(dtype));
    for (k = 0; k < n; k++) {
@@ -76,12 +94,15 @@ void compute_shortest_paths (int id, int p, dtype **a, int n)
       if (root == id) {
          offset = k - BLOCK_LOW(id,p,n);
          for (j = 0; j < n; j++)
-            tmp[j] = a[offset][j];
+            tmp[j] = a[offset*ld+j];
       }
       MPI_Bcast (tmp, n, MPI_TYPE, root, MPI_COMM_WORLD);
-      for (i = 0; i < BLOCK_SIZE(id,p,n); i++)
+      for (i = 0; i < BLOCK_SIZE(id,p,n); i++) {
+         row = a + (size_t) i * ld;
+         aik = row[k];
          for (j = 0; j < n; j++)
-            a[i][j] = MIN(a[i][j],a[i][k]+tmp[j]);
+            row[j] = MIN(row[j],aik+tmp[j]);
+      }
    }
    free (tmp);
 }
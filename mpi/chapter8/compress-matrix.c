@@ -0,0 +1,186 @@
+/*
+ *   Convert a matrix file into the chunked compressed form
+ *   read by 'read_row_striped_matrix' and
+ *   'read_checkerboard_matrix'. Each chunk of rows is
+ *   compressed on its own, so that every process can decode
+ *   just the rows it owns.
+ *
+ *   Usage: compress-matrix <in> <out> <chunk rows> [zlib|zstd]
+ *
+ *   Build with -DHAVE_ZLIB -lz and/or -DHAVE_ZSTD -lzstd.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../MyFile.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static int type_size (int type)
+{
+   switch (type) {
+      case TYPE_BYTE:    return sizeof(char);
+      case TYPE_INT:     return sizeof(int);
+      case TYPE_FLOAT:   return sizeof(float);
+      case TYPE_DOUBLE:  return sizeof(double);
+      case TYPE_INT64:   return sizeof(long long);
+      case TYPE_COMPLEX: return 2 * sizeof(double);
+   }
+   return 0;
+}
+
+/* Compress 'len' bytes of 'src' into 'dst', which holds
+   'cap' bytes. Return the compressed size, or 0 on error. */
+
+static size_t compress_chunk (int codec, void *dst, size_t cap,
+   void *src, size_t len)
+{
+#ifdef HAVE_ZLIB
+   uLongf out;
+
+   if (codec == CODEC_ZLIB) {
+      out = cap;
+      return (compress2 (dst, &out, src, len, 1) == Z_OK) ?
+         out : 0;
+   }
+#endif
+#ifdef HAVE_ZSTD
+   size_t bytes;
+
+   if (codec == CODEC_ZSTD) {
+      bytes = ZSTD_compress (dst, cap, src, len, 1);
+      return ZSTD_isError (bytes) ? 0 : bytes;
+   }
+#endif
+   (void) codec;
+   (void) dst;
+   (void) cap;
+   (void) src;
+   (void) len;
+   return 0;
+}
+
+static size_t chunk_bound (int codec, size_t len)
+{
+#ifdef HAVE_ZLIB
+   if (codec == CODEC_ZLIB) return compressBound (len);
+#endif
+#ifdef HAVE_ZSTD
+   if (codec == CODEC_ZSTD) return ZSTD_compressBound (len);
+#endif
+   (void) codec;
+   (void) len;
+   return 0;
+}
+
+int main (int argc, char *argv[])
+{
+   int        c;
+   void      *chunk;         /* Uncompressed rows */
+   int        chunk_rows;
+   int        codec;
+   FILE      *finptr;
+   FILE      *foutptr;
+   file_header h;
+   long long  i;
+   long long *index;         /* Offsets of chunks */
+   int        nchunks;
+   void      *packed;        /* Compressed rows */
+   size_t     packed_cap;
+   size_t     packed_len;
+   size_t     row_bytes;
+   long long  rows;
+
+   if (argc < 4) {
+      printf ("Usage: %s <in> <out> <chunk rows> [zlib|zstd]\n",
+         argv[0]);
+      return 1;
+   }
+   chunk_rows = atoi (argv[3]);
+   codec = CODEC_ZLIB;
+   if ((argc > 4) && !strcmp (argv[4], "zstd"))
+      codec = CODEC_ZSTD;
+   else if ((argc > 4) && strcmp (argv[4], "zlib")) {
+      printf ("Unknown codec '%s'\n", argv[4]);
+      return 1;
+   }
+   if (!chunk_bound (codec, 1)) {
+      printf ("Codec '%s' not built in\n", argc > 4 ?
+         argv[4] : "zlib");
+      return 1;
+   }
+   if (chunk_rows <= 0) {
+      printf ("Chunk rows must be positive\n");
+      return 1;
+   }
+
+   finptr = fopen (argv[1], "r");
+   if (finptr == NULL) {
+      printf ("Cannot open '%s'\n", argv[1]);
+      return 1;
+   }
+   if ((fread (&h, sizeof(file_header), 1, finptr) != 1) ||
+       (h.magic != FILE_MAGIC) || (h.version != FILE_VERSION) ||
+       (h.endian != ENDIAN_MARK) || (h.codec != CODEC_NONE) ||
+       (h.layout != LAYOUT_DENSE) || !type_size (h.type)) {
+      printf ("'%s' is not an uncompressed dense versioned file\n",
+         argv[1]);
+      return 1;
+   }
+   fseek (finptr, (long) h.offset, SEEK_SET);
+
+   row_bytes = (size_t) h.cols * type_size (h.type);
+   nchunks = (int) ((h.rows + chunk_rows - 1) / chunk_rows);
+   chunk = malloc (chunk_rows * row_bytes);
+   packed_cap = chunk_bound (codec, chunk_rows * row_bytes);
+   packed = malloc (packed_cap);
+   index = (long long *) malloc ((nchunks + 1) *
+      sizeof(long long));
+   if ((chunk == NULL) || (packed == NULL) || (index == NULL)) {
+      printf ("Out of memory\n");
+      return 1;
+   }
+
+   /* The index sits right after the header and is written
+      once the chunk sizes are known */
+
+   foutptr = fopen (argv[2], "w");
+   if (foutptr == NULL) {
+      printf ("Cannot create '%s'\n", argv[2]);
+      return 1;
+   }
+   h.codec = codec;
+   h.chunk_rows = chunk_rows;
+   h.offset = sizeof(file_header);
+   fwrite (&h, sizeof(file_header), 1, foutptr);
+   fwrite (index, sizeof(long long), nchunks + 1, foutptr);
+   index[0] = h.offset + (nchunks + 1) * sizeof(long long);
+   for (c = 0, i = 0; c < nchunks; c++, i += rows) {
+      rows = h.rows - i;
+      if (rows > chunk_rows) rows = chunk_rows;
+      if (fread (chunk, row_bytes, rows, finptr) != (size_t) rows) {
+         printf ("'%s' is truncated\n", argv[1]);
+         return 1;
+      }
+      packed_len = compress_chunk (codec, packed, packed_cap,
+         chunk, rows * row_bytes);
+      if (!packed_len) {
+         printf ("Compression failed\n");
+         return 1;
+      }
+      fwrite (packed, 1, packed_len, foutptr);
+      index[c+1] = index[c] + packed_len;
+   }
+   fseek (foutptr, (long) h.offset, SEEK_SET);
+   fwrite (index, sizeof(long long), nchunks + 1, foutptr);
+   fclose (foutptr);
+   fclose (finptr);
+   printf ("%lld bytes in, %lld bytes out\n",
+      h.offset + h.rows * (long long) row_bytes, index[nchunks]);
+   return 0;
+}
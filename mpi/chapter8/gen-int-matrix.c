@@ -1,12 +1,17 @@
 /* Generate a square matrix of integers and write the values
-   to a file. */
+   to a file. A third argument of "64" writes 64-bit
+   integers. */
 #include <stdio.h>
+#include <string.h>
+#include "../MyFile.h"
 main (int argc, char * argv[]) {
    int i, j;
    int n;
    FILE *foutptr;
+   file_header h;
    int *a;
    int *ptr;
+   long long *a64;
 
    printf ("argv[0] is '%s'\n", argv[0]);
    printf ("argv[1] is '%s'\n", argv[1]);
@@ -20,8 +25,22 @@ main (int argc, char * argv[]) {
          else *(ptr++) = (i + j) % 7;
    }
    foutptr = fopen (argv[2], "w");
-   fwrite (&n, sizeof(int), 1, foutptr);
-   fwrite (&n, sizeof(int), 1, foutptr);
-   fwrite (a, sizeof(int), n*n, foutptr);
+   memset (&h, 0, sizeof(file_header));
+   h.magic = FILE_MAGIC;
+   h.version = FILE_VERSION;
+   h.type = TYPE_INT;
+   if ((argc > 3) && !strcmp (argv[3], "64")) h.type = TYPE_INT64;
+   h.endian = ENDIAN_MARK;
+   h.rows = n;
+   h.cols = n;
+   h.offset = sizeof(file_header);
+   fwrite (&h, sizeof(file_header), 1, foutptr);
+   if (h.type == TYPE_INT64) {
+      a64 = (long long *) malloc ((size_t) n * n * sizeof(long long));
+      for (i = 0; i < n * n; i++) a64[i] = a[i];
+      fwrite (a64, sizeof(long long), n*n, foutptr);
+      free (a64);
+   } else
+      fwrite (a, sizeof(int), n*n, foutptr);
    fclose (foutptr);
 }
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../MyFile.h"
+
+/* Write the 5-point Laplacian of a k x k grid as a sparse
+   matrix of doubles with k*k rows. Row i*k+j holds 4 on the
+   diagonal and -1 for each neighbor of point (i,j). */
+
+int main (int argc, char * argv[]) {
+   int i, j;
+   int k;
+   long long nnz;
+   long long ptr;
+   int col;
+   double val;
+   FILE *foutptr;
+   file_header h;
+
+   if (argc != 3) {
+      printf ("Usage: %s <k> <file>\n", argv[0]);
+      return 1;
+   }
+   k = atoi (argv[1]);
+   foutptr = fopen (argv[2], "w");
+   if ((k <= 0) || (foutptr == NULL)) {
+      printf ("Cannot create '%s'\n", argv[2]);
+      return 1;
+   }
+   nnz = 5LL * k * k - 4LL * k;
+   memset (&h, 0, sizeof(file_header));
+   h.magic = FILE_MAGIC;
+   h.version = FILE_VERSION;
+   h.type = TYPE_DOUBLE;
+   h.endian = ENDIAN_MARK;
+   h.rows = (long long) k * k;
+   h.cols = (long long) k * k;
+   h.offset = sizeof(file_header);
+   h.layout = LAYOUT_CSR;
+   h.nnz = nnz;
+   fwrite (&h, sizeof(file_header), 1, foutptr);
+
+   /* Row pointers */
+
+   ptr = 0;
+   fwrite (&ptr, sizeof(long long), 1, foutptr);
+   for (i = 0; i < k; i++)
+      for (j = 0; j < k; j++) {
+         ptr += 1 + (i > 0) + (j > 0) + (j < k-1) + (i < k-1);
+         fwrite (&ptr, sizeof(long long), 1, foutptr);
+      }
+
+   /* Column indices, in increasing order within a row */
+
+   for (i = 0; i < k; i++)
+      for (j = 0; j < k; j++) {
+         if (i > 0) {
+            col = (i-1)*k + j;
+            fwrite (&col, sizeof(int), 1, foutptr);
+         }
+         if (j > 0) {
+            col = i*k + j-1;
+            fwrite (&col, sizeof(int), 1, foutptr);
+         }
+         col = i*k + j;
+         fwrite (&col, sizeof(int), 1, foutptr);
+         if (j < k-1) {
+            col = i*k + j+1;
+            fwrite (&col, sizeof(int), 1, foutptr);
+         }
+         if (i < k-1) {
+            col = (i+1)*k + j;
+            fwrite (&col, sizeof(int), 1, foutptr);
+         }
+      }
+
+   /* Values, in the same order */
+
+   for (i = 0; i < k; i++)
+      for (j = 0; j < k; j++) {
+         val = -1.0;
+         if (i > 0) fwrite (&val, sizeof(double), 1, foutptr);
+         if (j > 0) fwrite (&val, sizeof(double), 1, foutptr);
+         val = 4.0;
+         fwrite (&val, sizeof(double), 1, foutptr);
+         val = -1.0;
+         if (j < k-1) fwrite (&val, sizeof(double), 1, foutptr);
+         if (i < k-1) fwrite (&val, sizeof(double), 1, foutptr);
+      }
+   fclose (foutptr);
+   return 0;
+}
@@ -1,10 +1,13 @@
 /* Generate an n-element double vector and write it to a file */
 
 #include <stdio.h>
+#include <string.h>
+#include "../MyFile.h"
 main (int argc, char * argv[]) {
    int i, j;
    int n;
    FILE *foutptr;
+   file_header h;
    double *a;
    double *ptr;
 
@@ -18,7 +21,15 @@ main (int argc, char * argv[]) {
       *(ptr++) = (double) (i) / (double) (n);
    }
    foutptr = fopen (argv[2], "w");
-   fwrite (&n, sizeof(int), 1, foutptr);
+   memset (&h, 0, sizeof(file_header));
+   h.magic = FILE_MAGIC;
+   h.version = FILE_VERSION;
+   h.type = TYPE_DOUBLE;
+   h.endian = ENDIAN_MARK;
+   h.rows = n;
+   h.cols = 1;
+   h.offset = sizeof(file_header);
+   fwrite (&h, sizeof(file_header), 1, foutptr);
    fwrite (a, sizeof(double), n, foutptr);
    fclose (foutptr);
 }
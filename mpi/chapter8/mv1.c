@@ -3,7 +3,8 @@
  *
  *   This program multiplies a matrix and a vector input from
  *   separate files. The result vector is printed to standard
- *   output.
+ *   output and, if a third file name is given, written to
+ *   that file.
  *
  *   Data distribution of matrix: rowwise block striped
  *   Data distribution of vector: replicated 
@@ -24,13 +25,14 @@ typedef double dtype;
 #define mpitype MPI_DOUBLE
 
 int main (int argc, char *argv[]) {
-   dtype **a;       /* First factor, a matrix */
+   aligned_matrix a; /* First factor, a matrix */
    dtype *b;        /* Second factor, a vector */
    dtype *c_block;  /* Partial product vector */
    dtype *c;        /* Replicated product vector */
    double    max_seconds;
    double    seconds;    /* Elapsed time for matrix-vector multiply */
-   dtype *storage;  /* Matrix elements stored here */
+   dtype *ai;       /* Row i of matrix */
+   dtype  sum;      /* Accumulates c_block[i] */
    int    i, j;     /* Loop indices */
    int    id;       /* Process ID number */
    int    m;        /* Rows in matrix */
@@ -44,10 +46,10 @@ int main (int argc, char *argv[]) {
    MPI_Comm_rank (MPI_COMM_WORLD, &id);
    MPI_Comm_size (MPI_COMM_WORLD, &p);
 
-   read_row_striped_matrix (argv[1], (void *) &a,
-      (void *) &storage, mpitype, &m, &n, MPI_COMM_WORLD);
+   read_row_striped_aligned_matrix (argv[1], &a, mpitype, &m,
+      &n, 0, MPI_COMM_WORLD);
    rows = BLOCK_SIZE(id,p,m);
-   print_row_striped_matrix ((void **) a, mpitype, m, n,
+   print_row_striped_matrix (a.subs, mpitype, m, n,
       MPI_COMM_WORLD);
 
    read_replicated_vector (argv[2], (void *) &b, mpitype,
@@ -60,9 +62,11 @@ int main (int argc, char *argv[]) {
    MPI_Barrier (MPI_COMM_WORLD);
    seconds = - MPI_Wtime();
    for (i = 0; i < rows; i++) {
-      c_block[i] = 0.0;
+      ai = (dtype *) a.base + (size_t) i * a.ld;
+      sum = 0.0;
       for (j = 0; j < n; j++)
-         c_block[i] += a[i][j] * b[j];
+         sum += ai[j] * b[j];
+      c_block[i] = sum;
    }
 
    replicate_block_vector (c_block, n, (void *) c, mpitype,
@@ -71,13 +75,16 @@ int main (int argc, char *argv[]) {
    seconds += MPI_Wtime();
 
    print_replicated_vector (c, mpitype, n, MPI_COMM_WORLD);
+   if (argc > 3)
+      write_replicated_vector (argv[3], c, mpitype, n,
+         MPI_COMM_WORLD);
 
    MPI_Allreduce (&seconds, &max_seconds, 1, mpitype, MPI_MAX,
       MPI_COMM_WORLD);
    if (!id) {
       printf ("MV1) N = %d, Processes = %d, Time = %12.6f sec,",
          n, p, max_seconds);
-      printf ("Mflop = %6.2f\n", 2*n*n/(1000000.0*max_seconds));
+      printf ("Mflop = %6.2f\n", 2.0*n*n/(1000000.0*max_seconds));
    }
    MPI_Finalize();
    return 0;
@@ -3,7 +3,8 @@
  *
  *   This program multiplies a matrix and a vector.
  *   The matrix and vector are input from files.
- *   The answer is printed to standard output.
+ *   The answer is printed to standard output and, if a third
+ *   file name is given, written to that file.
  *
  *   Data distribution of matrix: columnwise block striped
  *   Data distribution of vector: block
@@ -91,9 +92,12 @@ int main (int argc, char *argv[]) {
    if (!id) {
       printf ("MV3) N = %d, Processes = %d, Time = %12.6f sec,",
          n, p, max_seconds);
-      printf ("Mflop = %6.2f\n", 2*n*n/(1000000.0*max_seconds));
+      printf ("Mflop = %6.2f\n", 2.0*n*n/(1000000.0*max_seconds));
    }
    print_block_vector ((void *) c, mpitype, n, MPI_COMM_WORLD);
+   if (argc > 3)
+      write_block_vector (argv[3], (void *) c, mpitype, n,
+         MPI_COMM_WORLD);
    MPI_Finalize();
    return 0;
 }
@@ -3,7 +3,8 @@
  *
  *   This program multiplies a matrix and a vector input from
  *   separate files. The result vector is printed to standard
- *   output.
+ *   output and, if a third file name is given, written to
+ *   that file.
  *
  *   Data distribution of matrix: checkerboard
  *   Data distribution of vector: blocked across procs in col 0
@@ -166,6 +167,9 @@ int main (int argc, char *argv[]) {
    MPI_Reduce(c_block, c_sums, rows, mpitype, MPI_SUM, 0, row_comm);
    if (grid_coords[1] == 0) {
       print_block_vector (c_sums, mpitype, n, col_comm);
+      if (argc > 3)
+         write_block_vector (argv[3], c_sums, mpitype, n,
+            col_comm);
    }
    MPI_Barrier(MPI_COMM_WORLD);
    seconds += MPI_Wtime();
@@ -176,7 +180,7 @@ int main (int argc, char *argv[]) {
    if (!id) {
       printf ("MV5) N = %d, Processes = %d, Time = %12.6f sec,",
          n, p, max_seconds);
-      printf ("Mflop = %6.2f\n", 2*n*n/(1000000.0*max_seconds));
+      printf ("Mflop = %6.2f\n", 2.0*n*n/(1000000.0*max_seconds));
    }
    MPI_Finalize();
    return 0;
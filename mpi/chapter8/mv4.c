@@ -0,0 +1,93 @@
+/*
+ *   Matrix-vector multiplication, Version 4
+ *
+ *   This program multiplies a matrix and a vector input from
+ *   separate files, like Version 1, but never holds more than
+ *   two blocks of matrix rows in memory. Each process streams
+ *   its rows from the file, multiplying one block while the
+ *   next is being read, so the matrix may be larger than the
+ *   memory of all the processes together. The optional third
+ *   argument is the number of rows per block.
+ *
+ *   Data distribution of matrix: rowwise block striped,
+ *                                streamed from the file
+ *   Data distribution of vector: replicated
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "../MyMPI.h"
+
+/* Change these two definitions when the matrix and vector
+   element types change */
+
+typedef double dtype;
+#define mpitype MPI_DOUBLE
+
+#define DEFAULT_BLOCK_ROWS 1024
+
+int main (int argc, char *argv[]) {
+   dtype **a;       /* Block of matrix rows */
+   dtype *b;        /* Second factor, a vector */
+   int    block_rows; /* Rows per block */
+   dtype *c_block;  /* Partial product vector */
+   dtype *c;        /* Replicated product vector */
+   double    max_seconds;
+   double    seconds;    /* Elapsed time for matrix-vector multiply */
+   dtype *ai;       /* Row i of matrix */
+   dtype  sum;      /* Accumulates c_block[i] */
+   int    i, j;     /* Loop indices */
+   int    id;       /* Process ID number */
+   int    k;        /* Rows in current block */
+   int    m;        /* Rows in matrix */
+   int    n;        /* Columns in matrix */
+   int    nprime;   /* Elements in vector */
+   int    p;        /* Number of processes */
+   row_stream rs;   /* This process's rows */
+
+   MPI_Init (&argc, &argv);
+   MPI_Comm_rank (MPI_COMM_WORLD, &id);
+   MPI_Comm_size (MPI_COMM_WORLD, &p);
+
+   block_rows = (argc > 3) ? atoi (argv[3]) : DEFAULT_BLOCK_ROWS;
+
+   read_replicated_vector (argv[2], (void *) &b, mpitype,
+      &nprime, MPI_COMM_WORLD);
+   print_replicated_vector (b, mpitype, nprime,
+      MPI_COMM_WORLD);
+
+   MPI_Barrier (MPI_COMM_WORLD);
+   seconds = - MPI_Wtime();
+   open_row_stream (argv[1], mpitype, block_rows, &m, &n,
+      MPI_COMM_WORLD, &rs);
+   c_block = (dtype *) malloc (rs.rows * sizeof(dtype));
+   c = (dtype *) malloc (m * sizeof(dtype));
+   while ((k = next_row_block (&rs, (void ***) &a))) {
+      for (i = 0; i < k; i++) {
+         ai = a[i];
+         sum = 0.0;
+         for (j = 0; j < n; j++)
+            sum += ai[j] * b[j];
+         c_block[rs.first + i] = sum;
+      }
+   }
+   close_row_stream (&rs);
+
+   replicate_block_vector (c_block, m, (void *) c, mpitype,
+      MPI_COMM_WORLD);
+   MPI_Barrier (MPI_COMM_WORLD);
+   seconds += MPI_Wtime();
+
+   print_replicated_vector (c, mpitype, m, MPI_COMM_WORLD);
+
+   MPI_Allreduce (&seconds, &max_seconds, 1, MPI_DOUBLE, MPI_MAX,
+      MPI_COMM_WORLD);
+   if (!id) {
+      printf ("MV4) N = %d, Processes = %d, Time = %12.6f sec,",
+         n, p, max_seconds);
+      printf ("Mflop = %6.2f\n", 2.0*m*n/(1000000.0*max_seconds));
+   }
+   MPI_Finalize();
+   return 0;
+}
@@ -0,0 +1,78 @@
+/*   MyFile.h
+ *
+ *   Layout of the files holding the matrices and vectors
+ *   read and written by the MyMPI library. It is kept apart
+ *   from MyMPI.h so that serial programs that generate input
+ *   files can use it without MPI.
+ *
+ *   A legacy file begins with the dimensions as ints (two
+ *   for a matrix, one for a vector), followed by the
+ *   elements in row-major order. A versioned file begins
+ *   with a 'file_header' and holds its elements from byte
+ *   'offset' onward, which is a multiple of DATA_ALIGNMENT so
+ *   that mapped data is aligned for vector loads. A vector
+ *   is stored as a matrix with one column.
+ *
+ *   In a compressed file ('codec' is not CODEC_NONE) the
+ *   rows are grouped into chunks of 'chunk_rows' rows, each
+ *   compressed on its own. Byte 'offset' then starts an index
+ *   of CEILING(rows,chunk_rows)+1 long longs; entry i is the
+ *   file offset of chunk i, and the last entry is the end of
+ *   the final chunk.
+ *
+ *   A sparse matrix ('layout' is LAYOUT_CSR) is stored in
+ *   compressed sparse row form. From byte 'offset' onward it
+ *   holds 'rows'+1 long long row pointers (entry i is the
+ *   number of nonzeros in rows 0 through i-1), then 'nnz'
+ *   int column indices, then 'nnz' element values.
+ */
+
+/************************* MACROS **************************/
+
+/* FILE_MAGIC can never be mistaken for the row count of a
+   legacy file, since it reads as a negative int */
+
+#define FILE_MAGIC         ((int) 0x9A4D5049)
+#define SWAPPED_FILE_MAGIC ((int) 0x49504D9A)
+#define FILE_VERSION       2
+#define ENDIAN_MARK        0x01020304
+#define DATA_ALIGNMENT     64
+#define MAX_HEADER_BYTES   64
+
+/* Compression of chunks */
+
+#define CODEC_NONE         0
+#define CODEC_ZLIB         1
+#define CODEC_ZSTD         2
+
+/* Arrangement of the elements */
+
+#define LAYOUT_DENSE       0
+#define LAYOUT_CSR         1
+
+/* Element type codes */
+
+#define TYPE_BYTE          1
+#define TYPE_INT           2
+#define TYPE_FLOAT         3
+#define TYPE_DOUBLE        4
+#define TYPE_INT64         5
+#define TYPE_COMPLEX       6    /* Pair of doubles: re, im */
+
+/************************* TYPES ***************************/
+
+typedef struct {
+   int       magic;        /* FILE_MAGIC */
+   int       version;      /* FILE_VERSION */
+   int       type;         /* Element type code */
+   int       endian;       /* ENDIAN_MARK, in writer's order */
+   long long rows;         /* Matrix rows, or vector length */
+   long long cols;         /* Matrix cols, or 1 */
+   long long offset;       /* Byte offset of first element,
+                              or of chunk index */
+   int       codec;        /* CODEC_NONE, or chunk codec */
+   int       chunk_rows;   /* Rows per compressed chunk */
+   int       layout;       /* LAYOUT_DENSE or LAYOUT_CSR */
+   char      reserved[4];  /* Zero */
+   long long nnz;          /* Nonzeros of a sparse matrix */
+} file_header;
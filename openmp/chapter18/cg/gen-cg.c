@@ -8,6 +8,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "MyFile.h"
 
 main (int argc, char *argv[])
 {
@@ -17,6 +19,7 @@ main (int argc, char *argv[])
    unsigned short xi[3];
    int n;
    FILE *fp;
+   file_header h;
 
    /* Initialize a and b so that solution is x[i] = i */
 
@@ -44,13 +47,21 @@ main (int argc, char *argv[])
    }
    printf ("Will put matrix in file '%s'\n", argv[2]);
    fp = fopen (argv[2], "w");
-   fwrite (&n, sizeof(int), 1, fp);
-   fwrite (&n, sizeof(int), 1, fp);
+   memset (&h, 0, sizeof(file_header));
+   h.magic = FILE_MAGIC;
+   h.version = FILE_VERSION;
+   h.type = TYPE_DOUBLE;
+   h.endian = ENDIAN_MARK;
+   h.rows = n;
+   h.cols = n;
+   h.offset = sizeof(file_header);
+   fwrite (&h, sizeof(file_header), 1, fp);
    fwrite (astorage, sizeof(double), n*n, fp);
    fclose (fp);
    printf ("Will put vector in file '%s'\n", argv[3]);
    fp = fopen (argv[3], "w");
-   fwrite (&n, sizeof(int), 1, fp);
+   h.cols = 1;
+   fwrite (&h, sizeof(file_header), 1, fp);
    fwrite (b, sizeof(double), n, fp);
    fclose (fp);
 }
@@ -59,10 +59,12 @@ cg (int p, int id, double **a, double *b, double *x, int n )
    double *g;                    /* Gradient vector */
    double  denom1, denom2, num1,
            num2, s, *tmpvec;     /* Temporaries */
+   replicate_plan g_plan;        /* Replicates 'piece' into g */
+   replicate_plan tmp_plan;      /* ... and into tmpvec */
 
    double dot_product (double *, double *, int);
    void matrix_vector_product (int, int, int, double **,
-                               double *, double *);
+                               double *, replicate_plan *);
 
    /* Initialize solution and gradient vectors */
 
@@ -71,6 +73,10 @@ cg (int p, int id, double **a, double *b, double *x, int n )
    tmpvec = (double *) malloc (n * sizeof(double));
    piece = (double *) malloc (BLOCK_SIZE(id,p,n) *
                               sizeof(double));
+   create_replicate_plan (piece, n, g, MPI_DOUBLE, MPI_COMM_WORLD,
+                          &g_plan);
+   create_replicate_plan (piece, n, tmpvec, MPI_DOUBLE,
+                          MPI_COMM_WORLD, &tmp_plan);
    for (i = 0; i < n; i++) {
       d[i] = x[i] = 0.0;
       g[i] = -b[i];
@@ -80,7 +86,8 @@ cg (int p, int id, double **a, double *b, double *x, int n )
 
    for (it = 0; it < n; it++) {
       denom1 = dot_product (g, g, n);
-      matrix_vector_product (id, p, n, a, x, g);
+      matrix_vector_product (id, p, n, a, x, &g_plan);
+      wait_replicate_plan (&g_plan);
       for (i = 0; i < n; i++)
          g[i] -= b[i];
       num1 = dot_product (g, g, n);
@@ -90,12 +97,18 @@ cg (int p, int id, double **a, double *b, double *x, int n )
 
       for (i = 0; i < n; i++)
          d[i] = -g[i] + (num1/denom1) * d[i];
+
+      /* Compute num2 while the product is being replicated */
+
+      matrix_vector_product (id, p, n, a, d, &tmp_plan);
       num2 = dot_product (d, g, n);
-      matrix_vector_product (id, p, n, a, d, tmpvec);
+      wait_replicate_plan (&tmp_plan);
       denom2 = dot_product (d, tmpvec, n);
       s = -num2 / denom2;
       for (i = 0; i < n; i++) x[i] += s * d[i];
    }
+   free_replicate_plan (&g_plan);
+   free_replicate_plan (&tmp_plan);
 }
 
 /*
@@ -114,12 +127,14 @@ double dot_product (double *a, double *b, int n)
 }
 
 /*
- *   Compute the product of matrix a and vector b and
- *   store the result in vector c
+ *   Compute the product of matrix a and vector b and start
+ *   replicating it into the vector of plan c. The caller
+ *   must wait on the plan before using that vector.
  */
 
 void matrix_vector_product (int id, int p, int n,
-                            double **a, double *b, double *c)
+                            double **a, double *b,
+                            replicate_plan *c)
 {
    int    i, j;
    double tmp;       /* Accumulates sum */
@@ -130,5 +145,5 @@ void matrix_vector_product (int id, int p, int n,
          tmp += a[i][j] * b[j];
       piece[i] = tmp;
    }
-   replicate_block_vector (piece, n, (void *) c, MPI_DOUBLE, MPI_COMM_WORLD);
+   start_replicate_plan (c);
 }